@@ -28,6 +28,20 @@
 #error arch not supported!
 #endif
 
+// build options
+#if !defined(ARENA_STATS)
+#define ARENA_STATS         0   // collect Arena_Stats, see arena_stats_dump()
+#endif
+#if !defined(ARENA_TRACE)
+#define ARENA_TRACE         0   // record push/temp/scratch events, see arena_trace_export()
+#endif
+#if !defined(ARENA_SCRATCH_COUNT)
+#define ARENA_SCRATCH_COUNT 4   // scratch arenas per thread, at most 32
+#endif
+#if !defined(ARENA_SCRATCH_RESERVE_SIZE)
+#define ARENA_SCRATCH_RESERVE_SIZE  0   // per scratch arena, 0 is ARENA_DEFAULT_RESERVE_SIZE
+#endif
+
 /*
  *
  */
@@ -38,6 +52,20 @@
 #define _THREAD_LOCAL   __thread
 #endif
 
+#if _IS_COMPILER_MSVC
+#define _NOINLINE       __declspec(noinline)
+#define _unlikely(x)    (x)
+#elif _IS_COMPILER_GCC || _IS_COMPILER_CLANG
+#define _NOINLINE       __attribute__((noinline, cold))
+#define _unlikely(x)    __builtin_expect(!!(x), 0)
+#endif
+
+#if _IS_COMPILER_MSVC
+#define _ALIGNED(n)     __declspec(align(n))
+#elif _IS_COMPILER_GCC || _IS_COMPILER_CLANG
+#define _ALIGNED(n)     __attribute__((aligned(n)))
+#endif
+
 #if _IS_COMPILER_MSVC
 #define _align_of(T)    __alignof(T)
 #elif _IS_COMPILER_CLANG
@@ -69,11 +97,82 @@ static void tag(void)
 #include <stddef.h>
 #include <stdint.h>
 #include <assert.h>
+#include <errno.h>
 #include <stdbool.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#if _IS_COMPILER_MSVC
+#include <intrin.h>
+#elif _IS_ARCH_X64
+#include <immintrin.h>
+#elif _IS_ARCH_ARM64
+#include <arm_neon.h>
+#endif
 
 static inline bool _is_pow2(size_t x)                       { return (x != 0) && ((x & (x - 1)) == 0); }
 static inline size_t _alignup_pow2(size_t n, size_t align)  { return (n + (align - 1)) & ~(align - 1); }
 
+// x must be non-zero
+static inline unsigned int _ctz64(uint64_t x) {
+#if _IS_COMPILER_MSVC
+    unsigned long idx;
+    _BitScanForward64(&idx, x);
+    return (unsigned int)idx;
+#else
+    return (unsigned int)__builtin_ctzll(x);
+#endif
+}
+
+// index of the highest set bit, x must be non-zero
+static inline unsigned int _bsr64(uint64_t x) {
+#if _IS_COMPILER_MSVC
+    unsigned long idx;
+    _BitScanReverse64(&idx, x);
+    return (unsigned int)idx;
+#else
+    return 63 - (unsigned int)__builtin_clzll(x);
+#endif
+}
+
+// spin-wait hint
+static inline void _cpu_relax(void) {
+#if _IS_COMPILER_MSVC
+    _mm_pause();
+#elif _IS_ARCH_X64
+    __builtin_ia32_pause();
+#elif _IS_ARCH_ARM64
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// size_t atomics, loads acquire, stores release, rmw sequentially consistent
+#if _IS_COMPILER_MSVC
+// x64 loads and stores are already acquire / release
+static inline size_t _atomic_load(volatile size_t *p)                 { size_t v = *p; _ReadWriteBarrier(); return v; }
+static inline void _atomic_store(volatile size_t *p, size_t v)        { _ReadWriteBarrier(); *p = v; }
+static inline size_t _atomic_fetch_add(volatile size_t *p, size_t v)  { return (size_t)_InterlockedExchangeAdd64((volatile __int64 *)p, (__int64)v); }
+static inline size_t _atomic_exchange(volatile size_t *p, size_t v)   { return (size_t)_InterlockedExchange64((volatile __int64 *)p, (__int64)v); }
+static inline bool _atomic_cas(volatile size_t *p, size_t expected, size_t desired) {
+    return (size_t)_InterlockedCompareExchange64((volatile __int64 *)p, (__int64)desired, (__int64)expected) == expected;
+}
+static inline bool _atomic_cas_ptr(void *volatile *p, void *expected, void *desired) {
+    return _InterlockedCompareExchangePointer(p, desired, expected) == expected;
+}
+#elif _IS_COMPILER_GCC || _IS_COMPILER_CLANG
+static inline size_t _atomic_load(volatile size_t *p)                 { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static inline void _atomic_store(volatile size_t *p, size_t v)        { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+static inline size_t _atomic_fetch_add(volatile size_t *p, size_t v)  { return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST); }
+static inline size_t _atomic_exchange(volatile size_t *p, size_t v)   { return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+static inline bool _atomic_cas(volatile size_t *p, size_t expected, size_t desired) {
+    return __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+static inline bool _atomic_cas_ptr(void *volatile *p, void *expected, void *desired) {
+    return __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#endif
+
 /*
  *
  */
@@ -98,6 +197,9 @@ _init(_os_win32_sysinfo_init) {
 #elif _IS_OS_LINUX
 
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 _init(_os_linux_pagesize_init) {
@@ -121,6 +223,50 @@ static inline void *_os_virtual_reserve(size_t size) {
     return ptr;
 }
 
+#if _IS_OS_LINUX
+// readable and writable up front, the kernel backs pages on first touch.
+// no swap or overcommit accounting is charged for the range
+static inline void *_os_virtual_reserve_rw(size_t size) {
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (ptr == MAP_FAILED) {
+        assert(false && "mmap(): reserve failed");
+        return NULL;
+    }
+    return ptr;
+}
+
+// over-reserves then trims the head and tail
+static inline void *_os_virtual_reserve_aligned(size_t size, size_t align) {
+    size_t total = size + align;
+    void *ptr = mmap(NULL, total, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        assert(false && "mmap(): reserve failed");
+        return NULL;
+    }
+
+    size_t addr = (size_t)ptr;
+    size_t head = _alignup_pow2(addr, align) - addr;
+    size_t tail = total - head - size;
+    if (head != 0) munmap(ptr, head);
+    if (tail != 0) munmap((char *)ptr + head + size, tail);
+    return (char *)ptr + head;
+}
+#endif
+
+// linux: hugetlbfs pages, reserved up front and committed with mprotect
+// windows: large pages, always committed
+// fails without assert when the system has no huge pages to spare
+static inline void *_os_virtual_reserve_large(size_t size) {
+    void *ptr = NULL;
+#if _IS_OS_WINDOWS
+    ptr = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+#elif _IS_OS_LINUX
+    ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ptr == MAP_FAILED) return NULL;
+#endif
+    return ptr;
+}
+
 static bool _os_virtual_commit(void *ptr, size_t size) {
 #if _IS_OS_WINDOWS
     void *res = VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE);
@@ -146,6 +292,30 @@ static bool _os_virtual_commit(void *ptr, size_t size) {
     return true;
 }
 
+static inline bool _os_virtual_decommit(void *ptr, size_t size) {
+#if _IS_OS_WINDOWS
+    if (!VirtualFree(ptr, size, MEM_DECOMMIT)) {
+        assert(false && "VirtualFree(): decommit failed");
+        return false;
+    }
+#elif _IS_OS_LINUX
+    mprotect(ptr, size, PROT_NONE);
+    madvise(ptr, size, MADV_DONTNEED);
+#endif
+    return true;
+}
+
+#if _IS_OS_LINUX
+// drops the pages but keeps the range accessible, the next touch faults in zeroes
+static inline bool _os_virtual_discard(void *ptr, size_t size) {
+    if (madvise(ptr, size, MADV_DONTNEED) == -1) {
+        assert(false && "madvise(): discard failed");
+        return false;
+    }
+    return true;
+}
+#endif
+
 static inline bool _os_virtual_release(void *ptr, size_t size) {
 #if _IS_OS_WINDOWS
     (void)size;
@@ -159,6 +329,200 @@ static inline bool _os_virtual_release(void *ptr, size_t size) {
     return true;
 }
 
+#if _IS_OS_LINUX && !defined(MADV_POPULATE_WRITE)
+#define MADV_POPULATE_WRITE 23  // linux 5.14
+#endif
+#if _IS_OS_LINUX && !defined(MFD_CLOEXEC)
+#define MFD_CLOEXEC         1u  // linux 3.17, memfd_create() through syscall()
+#endif
+
+// faults committed pages in without changing their contents
+static inline void _os_virtual_populate(void *ptr, size_t size) {
+#if _IS_OS_LINUX
+    if (madvise(ptr, size, MADV_POPULATE_WRITE) == 0 || errno != EINVAL) return;
+#endif
+    // older kernels and windows
+    for (size_t offset = 0; offset < size; offset += _os_pageSize) {
+        volatile char *byte = (char *)ptr + offset;
+        *byte = *byte;
+    }
+}
+
+/*
+ *
+ */
+
+#if ARENA_TRACE
+
+#if _IS_OS_LINUX
+#include <time.h>
+#endif
+
+#if !defined(ARENA_TRACE_RING_SIZE)
+#define ARENA_TRACE_RING_SIZE   (1u << 16)  // events per thread, power of 2
+#endif
+
+#if _IS_COMPILER_MSVC
+#define _return_address()   _ReturnAddress()
+#else
+#define _return_address()   __builtin_return_address(0)
+#endif
+
+// traced entry points stay out of line, so the return address taken there is the caller's call site.
+// the typed push macros expand in the caller and call them directly
+#if _IS_COMPILER_MSVC
+#define _TRACE_ENTRY    static __declspec(noinline)
+#else
+#define _TRACE_ENTRY    static __attribute__((noinline, unused))
+#endif
+// the call instruction, not the one after it that may belong to the next line
+#define _trace_site()   ((const char *)_return_address() - 1)
+
+typedef enum Arena_Trace_Kind {
+    ARENA_TRACE_PUSH = 0,
+    ARENA_TRACE_TEMP_BEGIN,
+    ARENA_TRACE_TEMP_END,
+    ARENA_TRACE_SCRATCH_BEGIN,
+    ARENA_TRACE_SCRATCH_END,
+} Arena_Trace_Kind;
+
+typedef struct Arena_Trace_Event {
+    uint64_t time;          // ns, monotonic clock
+    const void *arena;
+    const void *site;       // call site of the public function, symbolize with addr2line -i.
+                            // pushes made inside other arena functions point into those
+    size_t size;            // push size
+    size_t pos;             // arena pos after the event
+    Arena_Trace_Kind kind;
+} Arena_Trace_Event;
+
+// one ring per thread, only its thread writes it.
+// rings are linked into a global list and live until arena_trace_free()
+typedef struct _Arena_Trace_Ring {
+    struct _Arena_Trace_Ring *next;
+    uint64_t threadId;
+    volatile size_t head;   // events ever written
+    Arena_Trace_Event events[ARENA_TRACE_RING_SIZE];
+} _Arena_Trace_Ring;
+
+static void *volatile _arena_traceRings = NULL;
+static _THREAD_LOCAL _Arena_Trace_Ring *_arena_traceRing = NULL;
+
+static _Arena_Trace_Ring *_arena_trace_ring_new(void) {
+    // straight from the os, tracing must not show up in arena stats
+    size_t size = _alignup_pow2(sizeof(_Arena_Trace_Ring), _os_pageSize);
+    void *ptr = _os_virtual_reserve(size);
+    if (ptr == NULL) return NULL;
+    if (!_os_virtual_commit(ptr, size)) {
+        _os_virtual_release(ptr, size);
+        return NULL;
+    }
+
+    _Arena_Trace_Ring *ring = (_Arena_Trace_Ring *)ptr;
+#if _IS_OS_WINDOWS
+    ring->threadId = GetCurrentThreadId();
+#elif _IS_OS_LINUX
+    ring->threadId = (uint64_t)syscall(SYS_gettid);
+#endif
+
+    do {
+        ring->next = (_Arena_Trace_Ring *)_arena_traceRings;
+    } while (!_atomic_cas_ptr(&_arena_traceRings, ring->next, ring));
+
+    _arena_traceRing = ring;
+    return ring;
+}
+
+static void _arena_trace_event(Arena_Trace_Kind kind, const void *arena, size_t size, size_t pos, const void *site) {
+    _Arena_Trace_Ring *ring = _arena_traceRing;
+    if (ring == NULL) {
+        ring = _arena_trace_ring_new();
+        if (ring == NULL) return;
+    }
+
+#if _IS_OS_WINDOWS
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    uint64_t now = (uint64_t)((double)counter.QuadPart * 1e9 / (double)freq.QuadPart);
+#elif _IS_OS_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+
+    size_t head = ring->head;
+    ring->events[head & (ARENA_TRACE_RING_SIZE - 1)] = (Arena_Trace_Event) {
+        .time = now,
+        .arena = arena,
+        .site = site,
+        .size = size,
+        .pos = pos,
+        .kind = kind,
+    };
+    _atomic_store(&ring->head, head + 1);
+}
+
+#define _arena_trace(kind, arena, size, pos, site)  _arena_trace_event(kind, arena, size, pos, site)
+
+// chrome trace json (chrome://tracing, perfetto).
+// every arena gets its own async track, temps and scratches are slices on it and pushes instants.
+// scopes only nest within one arena, thread scoped slices would mis-nest when they close
+// out of order across arenas.
+// events written while exporting may show up torn, export from a quiet point
+static inline void arena_trace_export(FILE *file) {
+    static const char *names[] = { "push", "temp", "temp", "scratch", "scratch" };
+    static const char *phases[] = { "n", "b", "e", "b", "e" };
+
+#if _IS_OS_WINDOWS
+    unsigned long pid = GetCurrentProcessId();
+#elif _IS_OS_LINUX
+    unsigned long pid = (unsigned long)getpid();
+#endif
+
+    fprintf(file, "{\"traceEvents\":[");
+    bool first = true;
+    _Arena_Trace_Ring *ring = (_Arena_Trace_Ring *)_arena_traceRings;
+    for (; ring != NULL; ring = ring->next) {
+        size_t head = _atomic_load(&ring->head);
+        size_t tail = head > ARENA_TRACE_RING_SIZE ? head - ARENA_TRACE_RING_SIZE : 0;
+
+        for (size_t i = tail; i < head; i++) {
+            const Arena_Trace_Event *event = &ring->events[i & (ARENA_TRACE_RING_SIZE - 1)];
+            fprintf(file,
+                "%s\n{\"name\":\"%s\",\"cat\":\"arena\",\"ph\":\"%s\",\"id\":\"%p\","
+                "\"ts\":%.3f,\"pid\":%lu,\"tid\":%llu,"
+                "\"args\":{\"arena\":\"%p\",\"site\":\"%p\",\"size\":%zu,\"pos\":%zu}}",
+                first ? "" : ",", names[event->kind], phases[event->kind], event->arena, event->time / 1000.0,
+                pid, (unsigned long long)ring->threadId,
+                event->arena, event->site, event->size, event->pos
+            );
+            first = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+}
+
+// no thread may trace during or after this
+static inline void arena_trace_free(void) {
+    _Arena_Trace_Ring *ring = (_Arena_Trace_Ring *)_arena_traceRings;
+    _arena_traceRings = NULL;
+    while (ring != NULL) {
+        _Arena_Trace_Ring *next = ring->next;
+        _os_virtual_release(ring, _alignup_pow2(sizeof(_Arena_Trace_Ring), _os_pageSize));
+        ring = next;
+    }
+    _arena_traceRing = NULL;
+}
+
+#else
+
+#define _TRACE_ENTRY    static inline
+#define _trace_site()   NULL
+#define _arena_trace(kind, arena, size, pos, site)  ((void)(site))
+
+#endif  // ARENA_TRACE
+
 /*
  *
  */
@@ -169,6 +533,44 @@ static inline size_t gigabytes(size_t n) { return megabytes(n) * 1024; }
 
 #define ARENA_DEFAULT_RESERVE_SIZE      (megabytes(128))
 #define ARENA_DEFAULT_PER_COMMIT_SIZE   (kilobytes(8))
+#define ARENA_HUGE_PAGE_SIZE            (megabytes(2))
+#define ARENA_CACHE_LINE_SIZE           (64)
+#define ARENA_STREAM_CLEAR_SIZE         (kilobytes(256))    // clears at least this big bypass the cache
+
+// arena_init_flags flags
+#define ARENA_FLAG_HUGE_PAGES   (1u << 0)   // huge page aligned, transparent huge pages
+#define ARENA_FLAG_HUGE_TLB     (1u << 1)   // explicit huge pages, falls back to normal
+#define ARENA_FLAG_CHAINED      (1u << 2)   // reserve and link a new block when full
+#define ARENA_FLAG_DEMAND_PAGED (1u << 3)   // linux: map read-write up front, commits are accounting only
+
+typedef enum Arena_Page_Mode {
+    ARENA_PAGES_NORMAL = 0,
+    ARENA_PAGES_HUGE,       // transparent huge pages
+    ARENA_PAGES_HUGE_TLB,   // hugetlbfs on linux, large pages on windows
+} Arena_Page_Mode;
+
+// how much the slow path commits at once, see arena_set_growth()
+typedef enum Arena_Growth {
+    ARENA_GROWTH_FIXED = 0,     // perCommitSize steps
+    ARENA_GROWTH_GEOMETRIC,     // doubling steps up to a cap
+    ARENA_GROWTH_LEARNED,       // geometric, jumps to the previous high-water mark after a reset
+} Arena_Growth;
+
+#if ARENA_STATS
+// pushes are bucketed by size, bucket n counts [2^n, 2^(n+1)), the last one everything above
+#define ARENA_STATS_BUCKET_COUNT    (24)
+
+typedef struct Arena_Stats {
+    size_t peakPos;
+    size_t commitCount;
+    size_t commitBytes;
+    size_t decommitCount;
+    size_t decommitBytes;
+    size_t pushCount;
+    size_t pushBuckets[ARENA_STATS_BUCKET_COUNT];
+    size_t paddingBytes;    // lost to alignment
+} Arena_Stats;
+#endif
 
 typedef struct Arena {
     void *ptr;
@@ -176,33 +578,142 @@ typedef struct Arena {
     size_t committed;
     size_t reserved;
     size_t perCommitSize;
+    size_t pageSize;            // commit granularity
+    unsigned int flags;         // requested ARENA_FLAG_*
+    Arena_Page_Mode pageMode;   // obtained page mode
+    bool demandPaged;           // obtained ARENA_FLAG_DEMAND_PAGED, no commit syscalls
+
+    // decommit policy, see arena_set_decommit()
+    size_t decommitThreshold;
+    size_t decommitKeep;
+    size_t decommitted;     // total bytes returned to os
+
+    // bytes from max(pos, zeroPos) to committed are known zero, raised lazily on pop.
+    // see arena_push_zero()
+    size_t zeroPos;
+
+    // growth policy, see arena_set_growth()
+    Arena_Growth growth;
+    size_t commitStep;      // next geometric step
+    size_t maxCommitStep;
+    size_t peakCommitted;   // since the last reset
+    size_t learnedCommit;   // peak of the previous reset cycle
+
+    size_t prefaultWindow;  // see arena_set_prefault()
+
+    // file backed, see arena_file_create()/arena_file_open()
+    bool fileBacked;        // a header page precedes ptr
+    int fileFd;             // open while pushes grow the file, -1 otherwise
+    bool fileReadOnly;      // ARENA_FILE_READ_ONLY, nothing is committed and pushes fail
+
+    // chained mode, pos/committed/reserved are relative to the current block
+    size_t basePos;                 // arena pos of the current block start
+    struct _Arena_Block *prev;      // previous block, null for the first block
+
+#if ARENA_STATS
+    Arena_Stats stats;
+#endif
 } Arena;
 
-static Arena arena_init_ex(size_t reserveSize, size_t perCommitSize) {
+// previous block of a chained arena,
+// stored in an extra page past the end of the next block's reserved range
+typedef struct _Arena_Block {
+    void *ptr;
+    size_t committed;
+    size_t reserved;
+    size_t pageSize;
+    Arena_Page_Mode pageMode;
+    size_t basePos;
+    struct _Arena_Block *prev;
+} _Arena_Block;
+
+static Arena arena_init_flags(size_t reserveSize, size_t perCommitSize, unsigned int flags) {
+    void *ptr = NULL;
+    size_t pageSize = _os_pageSize;
+    size_t committed = 0;
+    Arena_Page_Mode pageMode = ARENA_PAGES_NORMAL;
+    bool demandPaged = false;
+
+    if (flags & ARENA_FLAG_HUGE_TLB) {
 #if _IS_OS_WINDOWS
-    // reserving less than 64KiB on windows is waste,
-    // ptr must be align with dwAllocationGranularity
-    reserveSize = _alignup_pow2(reserveSize, _os_win32_sysInfo.dwAllocationGranularity);
+        size_t largeSize = GetLargePageMinimum();
 #elif _IS_OS_LINUX
-    // linux can reserve 4KiB smallest, basically pagesize
-    reserveSize = _alignup_pow2(reserveSize, _os_pageSize);
+        size_t largeSize = ARENA_HUGE_PAGE_SIZE;
+#endif
+        if (largeSize != 0) {
+            size_t largeReserve = _alignup_pow2(reserveSize, largeSize);
+            ptr = _os_virtual_reserve_large(largeReserve);
+            if (ptr != NULL) {
+                reserveSize = largeReserve;
+                pageSize = largeSize;
+                pageMode = ARENA_PAGES_HUGE_TLB;
+#if _IS_OS_WINDOWS
+                committed = largeReserve;
+#endif
+            }
+        }
+    }
+
+#if _IS_OS_LINUX
+    if (ptr == NULL && (flags & ARENA_FLAG_HUGE_PAGES)) {
+        // huge pages need 2MiB aligned ranges, commits are rounded to them too
+        reserveSize = _alignup_pow2(reserveSize, ARENA_HUGE_PAGE_SIZE);
+        ptr = _os_virtual_reserve_aligned(reserveSize, ARENA_HUGE_PAGE_SIZE);
+        if (ptr == NULL) return (Arena) { 0 };
+
+        // fails when transparent huge pages are disabled
+        if (madvise(ptr, reserveSize, MADV_HUGEPAGE) == 0) {
+            pageSize = ARENA_HUGE_PAGE_SIZE;
+            pageMode = ARENA_PAGES_HUGE;
+        }
+        if ((flags & ARENA_FLAG_DEMAND_PAGED) && mprotect(ptr, reserveSize, PROT_READ | PROT_WRITE) == 0)
+            demandPaged = true;
+    }
 #endif
 
+    if (ptr == NULL) {
+#if _IS_OS_WINDOWS
+        // reserving less than 64KiB on windows is waste,
+        // ptr must be align with dwAllocationGranularity
+        reserveSize = _alignup_pow2(reserveSize, _os_win32_sysInfo.dwAllocationGranularity);
+#elif _IS_OS_LINUX
+        // linux can reserve 4KiB smallest, basically pagesize
+        reserveSize = _alignup_pow2(reserveSize, _os_pageSize);
+#endif
+        // ptr is already aligned for us
+#if _IS_OS_LINUX
+        if (flags & ARENA_FLAG_DEMAND_PAGED) {
+            ptr = _os_virtual_reserve_rw(reserveSize);
+            demandPaged = true;
+        } else
+#endif
+        ptr = _os_virtual_reserve(reserveSize);
+        if (ptr == NULL) return (Arena) { 0 };
+    }
+
     perCommitSize = perCommitSize < reserveSize ? perCommitSize : reserveSize;
 
     // align per_commit_size with pagesize
-    perCommitSize = _alignup_pow2(perCommitSize, _os_pageSize);
-    // ptr is already aligned for us
-    void *ptr = _os_virtual_reserve(reserveSize);
-    if (ptr == NULL) return (Arena) { 0 };
+    perCommitSize = _alignup_pow2(perCommitSize, pageSize);
 
     return (Arena) {
         .ptr = ptr,
+        .committed = committed,
         .reserved = reserveSize,
         .perCommitSize = perCommitSize,
+        .pageSize = pageSize,
+        .flags = flags,
+        .pageMode = pageMode,
+        .demandPaged = demandPaged,
+        .commitStep = perCommitSize,
+        .maxCommitStep = perCommitSize,
     };
 }
 
+static inline Arena arena_init_ex(size_t reserveSize, size_t perCommitSize) {
+    return arena_init_flags(reserveSize, perCommitSize, 0);
+}
+
 static inline Arena arena_init() {
     return arena_init_ex(
         ARENA_DEFAULT_RESERVE_SIZE,
@@ -210,137 +721,1698 @@ static inline Arena arena_init() {
     );
 }
 
+static inline Arena_Page_Mode arena_get_page_mode(const Arena *arena) {
+    return arena->pageMode;
+}
+
+// false when ARENA_FLAG_DEMAND_PAGED wasn't requested or isn't supported
+static inline bool arena_is_demand_paged(const Arena *arena) {
+    return arena->demandPaged;
+}
+
+#if _IS_OS_LINUX
+// a shared file mapping can't be touched past the end of the file
+static inline bool _arena_file_grow(const Arena *arena, void *ptr, size_t size) {
+    char *base = (char *)arena->ptr - _os_pageSize;
+    off_t fileSize = (off_t)((char *)ptr + size - base);
+
+    struct stat st;
+    if (fstat(arena->fileFd, &st) == -1) return false;
+    if (st.st_size >= fileSize) return true;
+    if (ftruncate(arena->fileFd, fileSize) == -1) {
+        assert(false && "ftruncate(): file grow failed");
+        return false;
+    }
+    return true;
+}
+#endif
+
+// demand paged arenas only move the accounting
+static inline bool _arena_commit(const Arena *arena, void *ptr, size_t size) {
+    if (arena->demandPaged) return true;
+#if _IS_OS_LINUX
+    if (arena->fileBacked && arena->fileFd >= 0 && !_arena_file_grow(arena, ptr, size)) return false;
+#endif
+    return _os_virtual_commit(ptr, size);
+}
+
+// bytes to commit for a push needing `needed` more, before clamping to reserved
+static inline size_t _arena_commit_size(Arena *arena, size_t needed) {
+    size_t newCommit = _alignup_pow2(needed, arena->perCommitSize);
+    if (arena->growth == ARENA_GROWTH_FIXED) return newCommit;
+
+    size_t step = arena->commitStep;
+    arena->commitStep = step * 2 < arena->maxCommitStep ? step * 2 : arena->maxCommitStep;
+    newCommit = newCommit > step ? newCommit : step;
+
+    if (arena->growth == ARENA_GROWTH_LEARNED && arena->learnedCommit > arena->committed) {
+        size_t learned = arena->learnedCommit - arena->committed;
+        newCommit = newCommit > learned ? newCommit : learned;
+    }
+    return newCommit;
+}
+
 static inline size_t arena_get_pos(const Arena *arena) {
     // may unaligned !!!
-    return arena->pos;
+    return arena->basePos + arena->pos;
 }
 
-static void *arena_push_ex(Arena *arena, size_t size, size_t align) {
-    // windows always zeroes fresh commits
-    assert(_is_pow2(align) && "alignment must be non-zero power of 2");
+static void *_arena_push_chained(Arena *arena, size_t size, size_t align, const void *site);
 
-    size_t lastPos = _alignup_pow2(arena->pos, align);
-    size_t postPos = lastPos + size;
+// stats, trace and the bump shared by both push paths
+static inline void *_arena_push_bump(Arena *arena, size_t size, size_t lastPos, size_t postPos, const void *site) {
+#if ARENA_STATS
+    Arena_Stats *stats = &arena->stats;
+    unsigned int bucket = size > 1 ? _bsr64(size) : 0;
+    bucket = bucket < ARENA_STATS_BUCKET_COUNT ? bucket : ARENA_STATS_BUCKET_COUNT - 1;
+    stats->pushCount++;
+    stats->pushBuckets[bucket]++;
+    stats->paddingBytes += lastPos - arena->pos;
+    if (arena->basePos + postPos > stats->peakPos)
+        stats->peakPos = arena->basePos + postPos;
+#else
+    (void)size;
+#endif
+
+    void *res = (char *)arena->ptr + lastPos;
+    arena->pos = postPos;
+    _arena_trace(ARENA_TRACE_PUSH, arena, size, arena->basePos + postPos, site);
+    return res;
+}
+
+// past committed: chains or commits
+static inline void *_arena_push_commit(
+    Arena *arena, size_t size, size_t align, size_t lastPos, size_t postPos, const void *site
+) {
+    if (arena->fileReadOnly) return NULL;
 
     size_t reserved = arena->reserved;
     if (postPos > reserved) {
+        if (arena->flags & ARENA_FLAG_CHAINED)
+            return _arena_push_chained(arena, size, align, site);
+
         assert(false && "reserved size exceeded");
         return NULL;
     }
 
+    // commit the prefault window too
     size_t committed = arena->committed;
-    if (postPos > committed) {
-        size_t needed = postPos - committed;
-        size_t newCommit = _alignup_pow2(needed, arena->perCommitSize);
+    size_t needed = postPos - committed + arena->prefaultWindow;
+    size_t newCommit = _arena_commit_size(arena, needed);
 
-        size_t maxCommit = reserved - committed;
-        newCommit = newCommit < maxCommit ? newCommit : maxCommit;
+    size_t maxCommit = reserved - committed;
+    newCommit = newCommit < maxCommit ? newCommit : maxCommit;
 
-        void *ptr = (char *)arena->ptr + committed;
-        if (!_os_virtual_commit(ptr, newCommit)) return NULL;
+    void *ptr = (char *)arena->ptr + committed;
+    if (!_arena_commit(arena, ptr, newCommit)) return NULL;
 
-        arena->committed += newCommit;
+    arena->committed += newCommit;
+    if (arena->committed > arena->peakCommitted)
+        arena->peakCommitted = arena->committed;
+    if (arena->prefaultWindow != 0) {
+        size_t from = _alignup_pow2(postPos, _os_pageSize);
+        if (from < arena->committed)
+            _os_virtual_populate((char *)arena->ptr + from, arena->committed - from);
     }
+#if ARENA_STATS
+    arena->stats.commitCount++;
+    arena->stats.commitBytes += newCommit;
+#endif
 
-    void *res = (char *)arena->ptr + lastPos;
-    arena->pos = postPos;
-    return res;
+    return _arena_push_bump(arena, size, lastPos, postPos, site);
 }
 
-static inline void arena_pop_to(Arena *arena, size_t to) { // TODO: decommit version
-    assert(arena->pos >= to && "trying to pop forward");
-    arena->pos = to;
-}
-static inline void arena_pop_by(Arena *arena, size_t by) { // TODO: decommit version
-    arena_pop_to(arena, arena->pos - by);
+// out of line so push call sites stay small
+static _NOINLINE void *_arena_push_slow(
+    Arena *arena, size_t size, size_t align, size_t lastPos, size_t postPos, const void *site
+) {
+    return _arena_push_commit(arena, size, align, lastPos, postPos, site);
 }
 
-static inline void arena_free(Arena *arena) {
-    if (arena->ptr != NULL)
-        _os_virtual_release(arena->ptr, arena->reserved);
-    *arena = (Arena) { 0 };
-}
+// committed <= reserved, so the fast path only compares against committed
+static inline void *_arena_push(Arena *arena, size_t size, size_t align, const void *site) {
+    // windows always zeroes fresh commits
+    assert(_is_pow2(align) && "alignment must be non-zero power of 2");
 
-#define arena_push(arena, T, count) (T *)arena_push_ex(arena, sizeof(T) * count, _align_of(T))
-#define arena_pop(arena, T, count)  arena_pop_by(arena, sizeof(T) * count)
+    // align the address, reservations are only page aligned
+    size_t base = (size_t)arena->ptr;
+    size_t lastPos = _alignup_pow2(base + arena->pos, align) - base;
+    size_t postPos = lastPos + size;
 
-/*
- *
- */
+    if (_unlikely(postPos > arena->committed))
+        return _arena_push_slow(arena, size, align, lastPos, postPos, site);
+    return _arena_push_bump(arena, size, lastPos, postPos, site);
+}
 
-typedef struct Arena_Temp {
-    Arena *arena;
-    size_t pos;
-} Arena_Temp;
+_TRACE_ENTRY void *arena_push_ex(Arena *arena, size_t size, size_t align) {
+    return _arena_push(arena, size, align, _trace_site());
+}
 
-static inline Arena_Temp arena_temp_begin(Arena *arena) { return (Arena_Temp) { arena, arena_get_pos(arena) }; }
-static inline void arena_temp_end(Arena_Temp temp)      { arena_pop_to(temp.arena, temp.pos); }
+// reserves a block big enough for the push and links the current one behind it
+static void *_arena_push_chained(Arena *arena, size_t size, size_t align, const void *site) {
+    size_t needed = size + align;
+    size_t reserveSize = arena->reserved > needed ? arena->reserved : needed;
 
-/*
- *
- */
+    // one extra page past reserved holds the previous block
+    Arena next = arena_init_flags(reserveSize + arena->pageSize, arena->perCommitSize, arena->flags);
+    if (next.ptr == NULL) return NULL;
 
-struct _Scratch {
-    Arena arena;
-    bool inUse;
-};
+    size_t reserved = next.reserved - next.pageSize;
+    _Arena_Block *block = (_Arena_Block *)((char *)next.ptr + reserved);
+    if (next.committed == 0 && !_arena_commit(&next, block, next.pageSize)) {
+        _os_virtual_release(next.ptr, next.reserved);
+        return NULL;
+    }
 
-#define PER_THREAD_SCRATCH_COUNT    (4)
-static _THREAD_LOCAL struct _Scratch
-    _scratches[PER_THREAD_SCRATCH_COUNT] = { 0 };
+    *block = (_Arena_Block) {
+        .ptr = arena->ptr,
+        .committed = arena->committed,
+        .reserved = arena->reserved,
+        .pageSize = arena->pageSize,
+        .pageMode = arena->pageMode,
+        .basePos = arena->basePos,
+        .prev = arena->prev,
+    };
 
-static inline struct _Scratch *_scratches_get() {
-    if (_scratches[0].arena.ptr == NULL) {
-        for (unsigned int i = 0; i < PER_THREAD_SCRATCH_COUNT; i++)
-            _scratches[i].arena = arena_init();
-    }
-    return _scratches;
+    arena->basePos += arena->pos;
+    arena->prev = block;
+    arena->ptr = next.ptr;
+    arena->pos = 0;
+    arena->zeroPos = 0;
+    arena->committed = next.committed < reserved ? next.committed : reserved;
+    arena->reserved = reserved;
+    arena->pageSize = next.pageSize;
+    arena->pageMode = next.pageMode;
+
+    return _arena_push(arena, size, align, site);
 }
 
-/*
- *
- */
+// releases the current block and makes the previous one current
+static void _arena_pop_block(Arena *arena) {
+    _Arena_Block block = *arena->prev;
 
-static inline Arena_Temp scratch_begin() {
-    struct _Scratch *scratches = _scratches_get();
+    arena->decommitted += arena->committed;
+#if ARENA_STATS
+    arena->stats.decommitCount++;
+    arena->stats.decommitBytes += arena->committed;
+#endif
+    _os_virtual_release(arena->ptr, arena->reserved + arena->pageSize);
 
-    for (unsigned int i = 0; i < PER_THREAD_SCRATCH_COUNT; i++) {
-        if (!scratches[i].inUse) {
-            scratches[i].inUse = true;
-            return arena_temp_begin(&scratches[i].arena);
-        }
-    }
+    arena->ptr = block.ptr;
+    arena->pos = block.reserved;
+    arena->zeroPos = block.committed;   // not tracked per block
+    arena->committed = block.committed;
+    arena->reserved = block.reserved;
+    arena->pageSize = block.pageSize;
+    arena->pageMode = block.pageMode;
+    arena->basePos = block.basePos;
+    arena->prev = block.prev;
+}
 
-    assert(false && "all scratch arenas in use");
-    return (Arena_Temp) { 0 };
+// threshold: decommit on pop when more than this many bytes are committed above pos, 0 disables
+// keep:      bytes kept committed above pos after a decommit (hysteresis), keep < threshold
+static inline void arena_set_decommit(Arena *arena, size_t threshold, size_t keep) {
+    assert((threshold == 0 || keep < threshold) && "keep must be less than threshold");
+    arena->decommitThreshold = threshold;
+    arena->decommitKeep = keep;
 }
-static inline bool scratch_end(Arena_Temp scratch) {
-    for (unsigned int i = 0; i < PER_THREAD_SCRATCH_COUNT; i++) {
-        if (scratch.arena == &_scratches[i].arena) {
-            _scratches[i].inUse = false;
-            arena_temp_end(scratch);
-            return true;
-        }
-    }
 
-    assert(false && "non-scratch argument passed");
-    return false;
+// fixed:     commit perCommitSize at a time, the default
+// geometric: double the commit step on every commit, from perCommitSize up to maxCommitStep
+// learned:   geometric, and after a pop to 0 the next commit jumps straight to
+//            the committed high-water mark of the previous cycle
+static inline void arena_set_growth(Arena *arena, Arena_Growth growth, size_t maxCommitStep) {
+    maxCommitStep = _alignup_pow2(maxCommitStep, arena->pageSize);
+    assert(maxCommitStep >= arena->perCommitSize && "max commit step below perCommitSize");
+    arena->growth = growth;
+    arena->commitStep = arena->perCommitSize;
+    arena->maxCommitStep = maxCommitStep;
+}
+
+// keeps window bytes committed ahead of pos and populates them in one call when committing,
+// instead of a page fault per first touch. 0 disables
+static inline void arena_set_prefault(Arena *arena, size_t window) {
+    arena->prefaultWindow = _alignup_pow2(window, arena->pageSize);
+}
+
+static inline size_t arena_get_decommitted(const Arena *arena) {
+    return arena->decommitted;
+}
+
+// returns committed pages above pos + keep to the os
+static bool arena_decommit(Arena *arena, size_t keep) {
+#if _IS_OS_WINDOWS
+    // large pages can't be decommitted
+    if (arena->pageMode == ARENA_PAGES_HUGE_TLB) return true;
+#endif
+    // file pages are written back, not decommitted
+    if (arena->fileBacked) return true;
+
+    // committed is always page aligned
+    size_t keepPos = _alignup_pow2(arena->pos + keep, arena->pageSize);
+    if (keepPos >= arena->committed) return true;
+
+    size_t size = arena->committed - keepPos;
+    void *ptr = (char *)arena->ptr + keepPos;
+#if _IS_OS_LINUX
+    bool ok = arena->demandPaged ? _os_virtual_discard(ptr, size) : _os_virtual_decommit(ptr, size);
+#else
+    bool ok = _os_virtual_decommit(ptr, size);
+#endif
+    if (!ok) return false;
+
+    // recommits come back zeroed
+    arena->committed = keepPos;
+    if (arena->zeroPos > keepPos) arena->zeroPos = keepPos;
+    arena->decommitted += size;
+#if ARENA_STATS
+    arena->stats.decommitCount++;
+    arena->stats.decommitBytes += size;
+#endif
+    return true;
+}
+
+static inline void arena_pop_to(Arena *arena, size_t to) {
+    assert(arena_get_pos(arena) >= to && "trying to pop forward");
+    while (to < arena->basePos)
+        _arena_pop_block(arena);
+    // everything below the old pos may have been written
+    if (arena->pos > arena->zeroPos) arena->zeroPos = arena->pos;
+    arena->pos = to - arena->basePos;
+
+    size_t threshold = arena->decommitThreshold;
+    if (threshold != 0 && arena->committed > arena->pos + threshold)
+        arena_decommit(arena, arena->decommitKeep);
+
+    // a reset ends the cycle the learned policy sizes the next one from
+    if (to == 0 && arena->growth == ARENA_GROWTH_LEARNED) {
+        arena->learnedCommit = arena->peakCommitted;
+        arena->peakCommitted = arena->committed;
+    }
+}
+static inline void arena_pop_by(Arena *arena, size_t by) {
+    arena_pop_to(arena, arena_get_pos(arena) - by);
+}
+
+static inline void arena_free(Arena *arena) {
+    while (arena->prev != NULL)
+        _arena_pop_block(arena);
+    if (arena->ptr != NULL) {
+#if _IS_OS_LINUX
+        if (arena->fileBacked) {
+            _os_virtual_release((char *)arena->ptr - _os_pageSize, arena->reserved + _os_pageSize);
+            if (arena->fileFd >= 0) close(arena->fileFd);
+        } else
+#endif
+        _os_virtual_release(arena->ptr, arena->reserved);
+    }
+    *arena = (Arena) { 0 };
+}
+
+#define arena_push(arena, T, count) (T *)arena_push_ex(arena, sizeof(T) * (count), _align_of(T))
+#define arena_pop(arena, T, count)  arena_pop_by(arena, sizeof(T) * (count))
+
+// memset for small sizes, non-temporal stores for big ones so they don't evict the cache
+static inline void _arena_clear(void *ptr, size_t size) {
+    if (size < ARENA_STREAM_CLEAR_SIZE) {
+        memset(ptr, 0, size);
+        return;
+    }
+
+    char *p = (char *)ptr;
+    size_t head = _alignup_pow2((size_t)p, ARENA_CACHE_LINE_SIZE) - (size_t)p;
+    memset(p, 0, head);
+    p += head;
+    size -= head;
+
+    size_t body = size & ~(size_t)(ARENA_CACHE_LINE_SIZE - 1);
+#if _IS_ARCH_X64
+#if defined(__AVX__)
+    __m256i zero = _mm256_setzero_si256();
+    for (size_t i = 0; i < body; i += 64) {
+        _mm256_stream_si256((__m256i *)(p + i), zero);
+        _mm256_stream_si256((__m256i *)(p + i + 32), zero);
+    }
+#else
+    __m128i zero = _mm_setzero_si128();
+    for (size_t i = 0; i < body; i += 64) {
+        _mm_stream_si128((__m128i *)(p + i), zero);
+        _mm_stream_si128((__m128i *)(p + i + 16), zero);
+        _mm_stream_si128((__m128i *)(p + i + 32), zero);
+        _mm_stream_si128((__m128i *)(p + i + 48), zero);
+    }
+#endif
+    // order the streaming stores before later ordinary stores
+    _mm_sfence();
+#elif _IS_ARCH_ARM64
+    uint8x16_t zero = vdupq_n_u8(0);
+    for (size_t i = 0; i < body; i += 64)
+        __asm__ __volatile__("stnp %q1, %q1, [%0]\n\tstnp %q1, %q1, [%0, #32]" : : "r"(p + i), "w"(zero) : "memory");
+#else
+    memset(p, 0, body);
+#endif
+    memset(p + body, 0, size - body);
+}
+
+// zeroed memory, only the part below the highest pos ever reached is cleared,
+// fresh commits and recommits after a decommit come zeroed from the os
+_TRACE_ENTRY void *arena_push_zero_ex(Arena *arena, size_t size, size_t align) {
+    void *block = arena->ptr;
+    size_t dirty = arena->pos > arena->zeroPos ? arena->pos : arena->zeroPos;
+
+    char *ptr = (char *)_arena_push(arena, size, align, _trace_site());
+    if (ptr == NULL) return NULL;
+    // chained into a fresh block
+    if (arena->ptr != block) return ptr;
+
+    size_t offset = (size_t)(ptr - (char *)arena->ptr);
+    if (offset < dirty)
+        _arena_clear(ptr, dirty - offset < size ? dirty - offset : size);
+    return ptr;
+}
+
+// arena_push_ex, spelled out where stale contents are fine
+_TRACE_ENTRY void *arena_push_nozero_ex(Arena *arena, size_t size, size_t align) {
+    return _arena_push(arena, size, align, _trace_site());
+}
+
+#define arena_push_zero(arena, T, count)    (T *)arena_push_zero_ex(arena, sizeof(T) * (count), _align_of(T))
+#define arena_push_nozero(arena, T, count)  (T *)arena_push_nozero_ex(arena, sizeof(T) * (count), _align_of(T))
+
+// grows or shrinks the last push in place, committing as needed.
+// false when ptr isn't the last push or the block has no room left
+static inline bool arena_extend(Arena *arena, void *ptr, size_t oldSize, size_t newSize) {
+    char *top = (char *)arena->ptr + arena->pos;
+    if ((char *)ptr + oldSize != top) return false;
+
+    if (newSize <= oldSize) {
+        arena_pop_by(arena, oldSize - newSize);
+        return true;
+    }
+
+    // never chain, the growth must stay contiguous
+    size_t grow = newSize - oldSize;
+    if (grow > arena->reserved - arena->pos) return false;
+    return arena_push_ex(arena, grow, 1) != NULL;
+}
+
+// in place when ptr is the last push, otherwise pushes and copies, the old block stays behind
+static inline void *arena_realloc(Arena *arena, void *ptr, size_t oldSize, size_t newSize, size_t align) {
+    if (ptr != NULL && arena_extend(arena, ptr, oldSize, newSize)) return ptr;
+
+    void *res = arena_push_ex(arena, newSize, align);
+    if (res != NULL && ptr != NULL)
+        memcpy(res, ptr, oldSize < newSize ? oldSize : newSize);
+    return res;
+}
+
+// one array of a arena_push_layout() push
+typedef struct Arena_Layout_Item {
+    size_t size;    // element size
+    size_t align;
+    size_t count;
+    void *out;      // T **, receives the array
+} Arena_Layout_Item;
+
+#define arena_layout_item(T, count, out) \
+    ((Arena_Layout_Item) { sizeof(T), _align_of(T), (count), (T **)(out) })
+// aligned to at least align, e.g. ARENA_CACHE_LINE_SIZE or a simd width
+#define arena_layout_item_aligned(T, count, align, out) \
+    ((Arena_Layout_Item) { sizeof(T), (align) > _align_of(T) ? (align) : _align_of(T), (count), (T **)(out) })
+
+// parallel arrays in one push, false when the push fails and the outs are untouched
+//   float *xs; int *ids;
+//   Arena_Layout_Item items[] = { arena_layout_item_aligned(float, n, 32, &xs), arena_layout_item(int, n, &ids) };
+//   arena_push_layout(arena, items, 2);
+static inline bool arena_push_layout(Arena *arena, const Arena_Layout_Item *items, size_t itemCount) {
+    size_t size = 0;
+    size_t align = 1;
+    for (size_t i = 0; i < itemCount; i++) {
+        assert(_is_pow2(items[i].align) && "alignment must be non-zero power of 2");
+        size = _alignup_pow2(size, items[i].align) + items[i].size * items[i].count;
+        align = items[i].align > align ? items[i].align : align;
+    }
+
+    char *base = (char *)arena_push_ex(arena, size, align);
+    if (base == NULL) return false;
+
+    size_t offset = 0;
+    for (size_t i = 0; i < itemCount; i++) {
+        offset = _alignup_pow2(offset, items[i].align);
+        void *ptr = base + offset;
+        memcpy(items[i].out, &ptr, sizeof(ptr));
+        offset += items[i].size * items[i].count;
+    }
+    return true;
+}
+
+/*
+ *
+ */
+
+typedef struct Arena_Temp {
+    Arena *arena;
+    size_t pos;
+} Arena_Temp;
+
+_TRACE_ENTRY Arena_Temp arena_temp_begin(Arena *arena) {
+    Arena_Temp temp = { arena, arena_get_pos(arena) };
+    _arena_trace(ARENA_TRACE_TEMP_BEGIN, arena, 0, temp.pos, _trace_site());
+    return temp;
+}
+_TRACE_ENTRY void arena_temp_end(Arena_Temp temp) {
+    arena_pop_to(temp.arena, temp.pos);
+    _arena_trace(ARENA_TRACE_TEMP_END, temp.arena, 0, temp.pos, _trace_site());
+}
+
+// a pushed window bumped through with a local pointer, for tight loops of small pushes.
+// no other pushes into the arena until arena_cursor_end(), which pops the unused tail
+typedef struct Arena_Cursor {
+    Arena *arena;
+    char *ptr;
+    char *end;
+} Arena_Cursor;
+
+static inline Arena_Cursor arena_cursor_begin(Arena *arena, size_t size) {
+    char *ptr = (char *)arena_push_ex(arena, size, 1);
+    if (ptr == NULL) return (Arena_Cursor) { 0 };
+    return (Arena_Cursor) { .arena = arena, .ptr = ptr, .end = ptr + size };
+}
+
+// null when the window is used up
+static inline void *arena_cursor_push_ex(Arena_Cursor *cursor, size_t size, size_t align) {
+    assert(_is_pow2(align) && "alignment must be non-zero power of 2");
+    size_t addr = _alignup_pow2((size_t)cursor->ptr, align);
+    if (_unlikely(addr + size > (size_t)cursor->end)) return NULL;
+    cursor->ptr = (char *)(addr + size);
+    return (void *)addr;
+}
+
+#define arena_cursor_push(cursor, T, count) (T *)arena_cursor_push_ex(cursor, sizeof(T) * (count), _align_of(T))
+
+static inline void arena_cursor_end(Arena_Cursor cursor) {
+    if (cursor.arena == NULL) return;
+    arena_pop_by(cursor.arena, (size_t)(cursor.end - cursor.ptr));
+}
+
+/*
+ *
+ */
+
+// null terminated, len excludes the terminator
+typedef struct Arena_Str {
+    char *ptr;
+    size_t len;
+} Arena_Str;
+
+// formats straight into the committed tail above pos,
+// measures and grows only when the tail is too small
+static inline Arena_Str arena_str_fmtva(Arena *arena, const char *fmt, va_list args) {
+    va_list copyArgs;
+    va_copy(copyArgs, args);
+
+    char *top = (char *)arena->ptr + arena->pos;
+    // read-only file arenas commit nothing below pos
+    size_t tail = arena->committed > arena->pos ? arena->committed - arena->pos : 0;
+
+    int bytes = vsnprintf(top, tail, fmt, args);
+    // the tail is written even when the string doesn't fit, see arena_push_zero()
+    size_t written = bytes < 0 || bytes + 1ull > tail ? tail : bytes + 1ull;
+    if (arena->pos + written > arena->zeroPos) arena->zeroPos = arena->pos + written;
+    if (bytes < 0) {    // bytes == 0: "" is valid string in c
+        assert(false && "vsnprintf(): failed");
+        va_end(copyArgs);
+        return (Arena_Str) { 0 };
+    }
+
+    // no commit when it fit, ptr == top
+    size_t neededBytes = bytes + 1ull;
+    char *ptr = arena_push(arena, char, neededBytes);
+    if (ptr != NULL && neededBytes > tail)
+        vsnprintf(ptr, neededBytes, fmt, copyArgs);
+    va_end(copyArgs);
+
+    if (ptr == NULL) return (Arena_Str) { 0 };
+    return (Arena_Str) { ptr, (size_t)bytes };
+}
+
+static inline Arena_Str arena_str_fmt(Arena *arena, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    Arena_Str res = arena_str_fmtva(arena, fmt, args);
+    va_end(args);
+    return res;
+}
+
+// drops the terminator when str is the last push, otherwise copies it to the top
+static inline bool _arena_str_to_top(Arena *arena, Arena_Str *str) {
+    // the append would fail anyway, keep pos as is
+    if (arena->fileReadOnly) return false;
+
+    char *top = (char *)arena->ptr + arena->pos;
+    if (str->ptr != NULL && str->ptr + str->len + 1 == top) {
+        arena_pop_by(arena, 1);
+        return true;
+    }
+
+    char *ptr = arena_push(arena, char, str->len);
+    if (ptr == NULL) return false;
+    if (str->len != 0) memcpy(ptr, str->ptr, str->len);
+    str->ptr = ptr;
+    return true;
+}
+
+// chained arenas may move to a new block in between, join the parts there
+static inline Arena_Str _arena_str_join(Arena *arena, Arena_Str head, Arena_Str tail) {
+    if (tail.ptr == head.ptr + head.len) return (Arena_Str) { head.ptr, head.len + tail.len };
+
+    char *ptr = arena_push(arena, char, head.len + tail.len + 1);
+    if (ptr == NULL) return (Arena_Str) { 0 };
+    memcpy(ptr, head.ptr, head.len);
+    memcpy(ptr + head.len, tail.ptr, tail.len + 1);
+    return (Arena_Str) { ptr, head.len + tail.len };
+}
+
+// in place when str is the last push
+static inline Arena_Str arena_str_append(Arena *arena, Arena_Str str, const char *data, size_t len) {
+    if (!_arena_str_to_top(arena, &str)) return (Arena_Str) { 0 };
+
+    char *ptr = arena_push(arena, char, len + 1);
+    if (ptr == NULL) return (Arena_Str) { 0 };
+    if (len != 0) memcpy(ptr, data, len);
+    ptr[len] = '\0';
+
+    return _arena_str_join(arena, str, (Arena_Str) { ptr, len });
+}
+
+static inline Arena_Str arena_str_append_fmtva(Arena *arena, Arena_Str str, const char *fmt, va_list args) {
+    if (!_arena_str_to_top(arena, &str)) return (Arena_Str) { 0 };
+
+    Arena_Str tail = arena_str_fmtva(arena, fmt, args);
+    if (tail.ptr == NULL) return (Arena_Str) { 0 };
+
+    return _arena_str_join(arena, str, tail);
+}
+
+static inline Arena_Str arena_str_append_fmt(Arena *arena, Arena_Str str, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    Arena_Str res = arena_str_append_fmtva(arena, str, fmt, args);
+    va_end(args);
+    return res;
+}
+
+/*
+ *
+ */
+
+#if _IS_OS_LINUX
+
+// arena backed by a file, the first page holds the header and the arena follows it.
+// every open maps it at a new address, store offsets in it, not pointers
+
+#define ARENA_FILE_MAGIC    (0x31414e4552415a4full)    // "OZARENA1"
+
+typedef struct Arena_File_Header {
+    uint64_t magic;
+    uint64_t pageSize;
+    uint64_t pos;           // as of the last arena_file_save()
+    uint64_t reserved;
+    uint64_t perCommitSize;
+} Arena_File_Header;
+
+typedef enum Arena_File_Mode {
+    ARENA_FILE_READ_ONLY = 0,   // shared read-only mapping, pushes fail
+    ARENA_FILE_COPY_ON_WRITE,   // private mapping, writes and pushes never reach the file
+    ARENA_FILE_READ_WRITE,      // shared mapping, pushes grow the file
+} Arena_File_Mode;
+
+static inline Arena_File_Header *_arena_file_header(const Arena *arena) {
+    return (Arena_File_Header *)((char *)arena->ptr - _os_pageSize);
+}
+
+// fileSize bytes of the file are accessible, the rest of the reserve is committed by pushes
+static inline Arena _arena_file_map(int fd, size_t reserveSize, size_t perCommitSize, size_t fileSize, Arena_File_Mode mode) {
+    size_t mapSize = _os_pageSize + reserveSize;
+    void *base = MAP_FAILED;
+
+    if (mode == ARENA_FILE_READ_ONLY) {
+        reserveSize = fileSize - _os_pageSize;
+        base = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    } else if (mode == ARENA_FILE_COPY_ON_WRITE) {
+        // anonymous reservation with the file mapped privately over its head
+        void *reserve = _os_virtual_reserve(mapSize);
+        if (reserve == NULL) return (Arena) { 0 };
+        base = mmap(reserve, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+        if (base == MAP_FAILED) _os_virtual_release(reserve, mapSize);
+    } else {
+        base = mmap(NULL, mapSize, PROT_NONE, MAP_SHARED, fd, 0);
+        if (base != MAP_FAILED && mprotect(base, fileSize, PROT_READ | PROT_WRITE) == -1) {
+            munmap(base, mapSize);
+            base = MAP_FAILED;
+        }
+    }
+    if (base == MAP_FAILED) return (Arena) { 0 };
+
+    perCommitSize = perCommitSize < reserveSize ? perCommitSize : reserveSize;
+    perCommitSize = _alignup_pow2(perCommitSize, _os_pageSize);
+
+    // the mapping is PROT_READ, so no byte of it counts as committed
+    size_t committed = mode == ARENA_FILE_READ_ONLY ? 0 : fileSize - _os_pageSize;
+    return (Arena) {
+        .ptr = (char *)base + _os_pageSize,
+        .committed = committed,
+        .zeroPos = committed,   // file contents past pos are stale
+        .reserved = reserveSize,
+        .perCommitSize = perCommitSize,
+        .pageSize = _os_pageSize,
+        .commitStep = perCommitSize,
+        .maxCommitStep = perCommitSize,
+        .fileBacked = true,
+        .fileFd = mode == ARENA_FILE_READ_WRITE ? fd : -1,
+        .fileReadOnly = mode == ARENA_FILE_READ_ONLY,
+    };
+}
+
+// creates or truncates path, pushes grow the file
+static inline Arena arena_file_create(const char *path, size_t reserveSize, size_t perCommitSize) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) return (Arena) { 0 };
+
+    reserveSize = _alignup_pow2(reserveSize, _os_pageSize);
+    Arena res = { 0 };
+    if (ftruncate(fd, _os_pageSize) == 0)
+        res = _arena_file_map(fd, reserveSize, perCommitSize, _os_pageSize, ARENA_FILE_READ_WRITE);
+    if (res.ptr == NULL) {
+        close(fd);
+        return (Arena) { 0 };
+    }
+
+    *_arena_file_header(&res) = (Arena_File_Header) {
+        .magic = ARENA_FILE_MAGIC,
+        .pageSize = _os_pageSize,
+        .pos = 0,
+        .reserved = res.reserved,
+        .perCommitSize = res.perCommitSize,
+    };
+    return res;
+}
+
+// maps a saved arena as is, one mmap whatever its size.
+// fails without assert on missing or foreign files
+static inline Arena arena_file_open(const char *path, Arena_File_Mode mode) {
+    int fd = open(path, mode == ARENA_FILE_READ_WRITE ? O_RDWR : O_RDONLY);
+    if (fd == -1) return (Arena) { 0 };
+
+    Arena_File_Header header;
+    struct stat st;
+    bool valid =
+        pread(fd, &header, sizeof(header), 0) == sizeof(header) && fstat(fd, &st) == 0 &&
+        header.magic == ARENA_FILE_MAGIC && header.pageSize == _os_pageSize &&
+        (size_t)st.st_size % _os_pageSize == 0 && (size_t)st.st_size >= _os_pageSize + header.pos &&
+        (size_t)st.st_size <= _os_pageSize + header.reserved;
+
+    Arena res = { 0 };
+    if (valid) res = _arena_file_map(fd, header.reserved, header.perCommitSize, st.st_size, mode);
+    if (res.ptr == NULL || mode != ARENA_FILE_READ_WRITE) close(fd);
+
+    res.pos = res.ptr != NULL ? header.pos : 0;
+    return res;
+}
+
+// persists pos and flushes the file, read-write file arenas only
+static inline bool arena_file_save(Arena *arena) {
+    if (!arena->fileBacked || arena->fileFd < 0) return false;
+
+    Arena_File_Header *header = _arena_file_header(arena);
+    header->pos = arena->pos;
+    size_t size = _alignup_pow2(_os_pageSize + arena->pos, _os_pageSize);
+    if (msync(header, size, MS_SYNC) == -1) {
+        assert(false && "msync(): save failed");
+        return false;
+    }
+    return true;
+}
+
+#endif  // _IS_OS_LINUX
+
+/*
+ *
+ */
+
+// arena that many threads can push into at once.
+// pos is bumped with a compare-and-swap, one thread at a time commits.
+// pop and free are not thread safe
+
+#define ARENA_SHARED_GRAIN  (16)    // pos is always a multiple of it
+
+// the hot counter gets a cache line to itself
+typedef struct Arena_Shared {
+    _ALIGNED(64) volatile size_t pos;
+
+    _ALIGNED(64) void *ptr;
+    volatile size_t committed;
+    volatile size_t committing;
+    size_t reserved;
+    size_t perCommitSize;
+} Arena_Shared;
+// pos must start a cache line, fails to compile otherwise
+typedef char _arena_shared_align_check[_align_of(Arena_Shared) == 64 ? 1 : -1];
+
+static inline bool arena_shared_init(Arena_Shared *arena, size_t reserveSize, size_t perCommitSize, unsigned int flags) {
+    assert(!(flags & ARENA_FLAG_CHAINED) && "shared arenas can't be chained");
+
+    Arena base = arena_init_flags(reserveSize, perCommitSize, flags);
+    if (base.ptr == NULL) return false;
+
+    *arena = (Arena_Shared) {
+        .ptr = base.ptr,
+        // demand paged arenas never take the commit lock
+        .committed = base.demandPaged ? base.reserved : base.committed,
+        .reserved = base.reserved,
+        .perCommitSize = base.perCommitSize,
+    };
+    return true;
+}
+
+static inline size_t arena_shared_get_pos(Arena_Shared *arena) {
+    return _atomic_load(&arena->pos);
+}
+
+static bool _arena_shared_commit(Arena_Shared *arena, size_t postPos) {
+    size_t reserved = arena->reserved;
+    if (postPos > reserved) {
+        assert(false && "reserved size exceeded");
+        return false;
+    }
+
+    for (;;) {
+        size_t committed = _atomic_load(&arena->committed);
+        if (postPos <= committed) return true;
+
+        // one thread commits, the rest wait until their range is covered
+        if (_atomic_exchange(&arena->committing, 1) != 0) {
+            _cpu_relax();
+            continue;
+        }
+
+        bool ok = true;
+        committed = _atomic_load(&arena->committed);
+        if (postPos > committed) {
+            size_t needed = postPos - committed;
+            size_t newCommit = _alignup_pow2(needed, arena->perCommitSize);
+
+            size_t maxCommit = reserved - committed;
+            newCommit = newCommit < maxCommit ? newCommit : maxCommit;
+
+            void *ptr = (char *)arena->ptr + committed;
+            ok = _os_virtual_commit(ptr, newCommit);
+            if (ok) _atomic_store(&arena->committed, committed + newCommit);
+        }
+
+        _atomic_store(&arena->committing, 0);
+        return ok;
+    }
+}
+
+// null once the reservation can't fit the push. which push that is depends on timing,
+// so it doesn't assert. pos never passes the reservation, smaller pushes may still fit
+static inline void *arena_shared_push_ex(Arena_Shared *arena, size_t size, size_t align) {
+    assert(_is_pow2(align) && "alignment must be non-zero power of 2");
+
+    // pos stays a multiple of the grain, both sizes and alignments round up to it
+    size = _alignup_pow2(size, ARENA_SHARED_GRAIN);
+    size_t base = (size_t)arena->ptr;
+    size_t lastPos, postPos;
+    for (;;) {
+        size_t pos = _atomic_load(&arena->pos);
+        lastPos = _alignup_pow2(base + pos, align) - base;
+        postPos = lastPos + size;
+        if (postPos > arena->reserved || postPos < lastPos) return NULL;
+        if (_atomic_cas(&arena->pos, pos, postPos)) break;
+    }
+
+    if (postPos > _atomic_load(&arena->committed)) {
+        if (!_arena_shared_commit(arena, postPos)) return NULL;
+    }
+
+    return (char *)arena->ptr + lastPos;
+}
+
+// no pushes may be in flight
+static inline void arena_shared_pop_to(Arena_Shared *arena, size_t to) {
+    assert(arena_shared_get_pos(arena) >= to && "trying to pop forward");
+    _atomic_store(&arena->pos, _alignup_pow2(to, ARENA_SHARED_GRAIN));
+}
+
+static inline void arena_shared_free(Arena_Shared *arena) {
+    if (arena->ptr != NULL)
+        _os_virtual_release(arena->ptr, arena->reserved);
+    *arena = (Arena_Shared) { 0 };
+}
+
+#define arena_shared_push(arena, T, count)  (T *)arena_shared_push_ex(arena, sizeof(T) * (count), _align_of(T))
+
+/*
+ *
+ */
+
+#if _IS_OS_LINUX
+
+// arena in a memfd or named shm object that several processes map at once.
+// pushes bump pos in the shared header, commits grow the object with fallocate.
+// every process maps it at its own address, exchange offsets or Rel_Ptr, not pointers.
+// producers publish the end of finished data, consumers read up to it
+
+#define ARENA_SHM_MAGIC     (0x314d48535a4full)     // "OZSHM1"
+
+typedef struct Arena_Shm_Info {
+    uint64_t magic;
+    size_t reserved;
+    size_t perCommitSize;
+} Arena_Shm_Info;
+
+// first page of the object
+typedef struct Arena_Shm_Header {
+    Arena_Shm_Info info;
+    char _pad0[64 - sizeof(Arena_Shm_Info)];
+    volatile size_t pos;
+    char _pad1[64 - sizeof(size_t)];    // keep the hot counter on its own cache line
+    volatile size_t committed;
+    volatile size_t published;
+} Arena_Shm_Header;
+
+typedef struct Arena_Shm {
+    Arena_Shm_Header *header;
+    char *ptr;          // data, the page after the header
+    size_t reserved;
+    size_t perCommitSize;
+    int fd;
+    bool readOnly;
+} Arena_Shm;
+
+static inline bool _arena_shm_map(Arena_Shm *arena, int fd, size_t reserved, bool readOnly) {
+    // pages past the end of the object fault until a commit covers them
+    int prot = readOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+    void *base = mmap(NULL, _os_pageSize + reserved, prot, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) return false;
+
+    arena->header = (Arena_Shm_Header *)base;
+    arena->ptr = (char *)base + _os_pageSize;
+    arena->reserved = reserved;
+    arena->fd = fd;
+    arena->readOnly = readOnly;
+    return true;
+}
+
+// name null: an anonymous memfd, hand arena->fd to other processes over a unix socket or fork.
+// otherwise a named shm object, see arena_shm_open() and arena_shm_unlink()
+static inline bool arena_shm_create(Arena_Shm *arena, const char *name, size_t reserveSize, size_t perCommitSize) {
+    int fd = name == NULL
+        ? (int)syscall(SYS_memfd_create, "arena", MFD_CLOEXEC)
+        : shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1) return false;
+
+    reserveSize = _alignup_pow2(reserveSize, _os_pageSize);
+    perCommitSize = perCommitSize < reserveSize ? perCommitSize : reserveSize;
+    perCommitSize = _alignup_pow2(perCommitSize, _os_pageSize);
+
+    if (posix_fallocate(fd, 0, _os_pageSize) != 0 || !_arena_shm_map(arena, fd, reserveSize, false)) {
+        close(fd);
+        if (name != NULL) shm_unlink(name);
+        return false;
+    }
+
+    *arena->header = (Arena_Shm_Header) {
+        .info = { ARENA_SHM_MAGIC, reserveSize, perCommitSize },
+    };
+    arena->perCommitSize = perCommitSize;
+    return true;
+}
+
+// takes ownership of fd, read-only arenas can't push.
+// fails without assert on foreign objects
+static inline bool arena_shm_open_fd(Arena_Shm *arena, int fd, bool readOnly) {
+    Arena_Shm_Info info;
+    if (pread(fd, &info, sizeof(info), 0) != sizeof(info) || info.magic != ARENA_SHM_MAGIC ||
+        !_arena_shm_map(arena, fd, info.reserved, readOnly)) {
+        close(fd);
+        return false;
+    }
+
+    arena->perCommitSize = info.perCommitSize;
+    return true;
+}
+
+static inline bool arena_shm_open(Arena_Shm *arena, const char *name, bool readOnly) {
+    int fd = shm_open(name, readOnly ? O_RDONLY : O_RDWR, 0);
+    if (fd == -1) return false;
+    return arena_shm_open_fd(arena, fd, readOnly);
+}
+
+// the object lives on while other processes map it
+static inline void arena_shm_close(Arena_Shm *arena) {
+    if (arena->header != NULL) {
+        munmap(arena->header, _os_pageSize + arena->reserved);
+        close(arena->fd);
+    }
+    *arena = (Arena_Shm) { 0 };
+}
+
+// removes the name, mappings stay valid
+static inline bool arena_shm_unlink(const char *name) {
+    return shm_unlink(name) == 0;
+}
+
+static inline size_t arena_shm_get_pos(const Arena_Shm *arena) {
+    return arena->header->pos;
+}
+
+static bool _arena_shm_commit(Arena_Shm *arena, size_t postPos) {
+    volatile size_t *committed = &arena->header->committed;
+    size_t current = _atomic_load(committed);
+    if (postPos <= current) return true;
+
+    size_t target = _alignup_pow2(postPos, arena->perCommitSize);
+    target = target < arena->reserved ? target : arena->reserved;
+
+    // fallocate never shrinks, racing processes may all grow it
+    if (posix_fallocate(arena->fd, 0, _os_pageSize + target) != 0) {
+        assert(false && "posix_fallocate(): commit failed");
+        return false;
+    }
+    while (current < target && !_atomic_cas(committed, current, target))
+        current = _atomic_load(committed);
+    return true;
+}
+
+static inline void *arena_shm_push_ex(Arena_Shm *arena, size_t size, size_t align) {
+    assert(!arena->readOnly && "read-only shm arena");
+    assert(_is_pow2(align) && align <= _os_pageSize && "alignment must be a power of 2 up to the page size");
+
+    // data starts page aligned, aligning offsets aligns addresses in every process.
+    // like arena_shared_push_ex(), pos never passes the reservation
+    size = _alignup_pow2(size, ARENA_SHARED_GRAIN);
+    size_t lastPos, postPos;
+    for (;;) {
+        size_t pos = _atomic_load(&arena->header->pos);
+        lastPos = _alignup_pow2(pos, align);
+        postPos = lastPos + size;
+        if (postPos > arena->reserved || postPos < lastPos) return NULL;
+        if (_atomic_cas(&arena->header->pos, pos, postPos)) break;
+    }
+    if (postPos > _atomic_load(&arena->header->committed)) {
+        if (!_arena_shm_commit(arena, postPos)) return NULL;
+    }
+
+    return arena->ptr + lastPos;
+}
+
+// everything written before publishing is visible to consumers that read up to pos
+static inline void arena_shm_publish(Arena_Shm *arena, size_t pos) {
+    volatile size_t *published = &arena->header->published;
+    size_t current = _atomic_load(published);
+    while (current < pos && !_atomic_cas(published, current, pos))
+        current = _atomic_load(published);
+}
+
+static inline size_t arena_shm_get_published(const Arena_Shm *arena) {
+    return _atomic_load(&arena->header->published);
+}
+
+static inline size_t arena_shm_offset_of(const Arena_Shm *arena, const void *ptr) {
+    return (size_t)((const char *)ptr - arena->ptr);
+}
+
+#define arena_shm_push(arena, T, count)         (T *)arena_shm_push_ex(arena, sizeof(T) * (count), _align_of(T))
+#define arena_shm_ptr_at(arena, T, offset)      (T *)((arena)->ptr + (offset))
+
+#endif  // _IS_OS_LINUX
+
+/*
+ *
+ */
+
+// ring of size bytes mapped twice back to back, a push that wraps the end stays contiguous.
+// frees in push order by releasing up to a position, not thread safe.
+// positions only grow, the offset in the ring is pos & (size - 1)
+
+typedef struct Arena_Ring {
+    char *ptr;
+    size_t size;        // power of 2, multiple of the allocation granularity
+    size_t head;        // next push
+    size_t tail;        // oldest unreleased byte
+} Arena_Ring;
+
+// the mapping is aligned to this, and ring sizes are multiples of it
+static inline size_t _arena_ring_granularity(void) {
+#if _IS_OS_WINDOWS
+    return _os_win32_sysInfo.dwAllocationGranularity;
+#elif _IS_OS_LINUX
+    return _os_pageSize;
+#endif
+}
+
+// size is rounded up to a power of 2
+static inline bool arena_ring_init(Arena_Ring *ring, size_t size) {
+    size_t granularity = _arena_ring_granularity();
+    size = size > granularity ? size : granularity;
+    size = (size_t)1 << (_bsr64(size - 1) + 1);
+
+    void *base = NULL;
+#if _IS_OS_WINDOWS
+    HANDLE mapping = CreateFileMappingA(
+        INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+        (DWORD)((uint64_t)size >> 32), (DWORD)size, NULL
+    );
+    if (mapping == NULL) return false;
+
+    // another thread may take the range between the probe and the views, retry
+    for (int attempt = 0; attempt < 16 && base == NULL; attempt++) {
+        void *probe = VirtualAlloc(NULL, size * 2, MEM_RESERVE, PAGE_NOACCESS);
+        if (probe == NULL) break;
+        VirtualFree(probe, 0, MEM_RELEASE);
+
+        void *first = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size, probe);
+        if (first == NULL) continue;
+        void *second = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size, (char *)probe + size);
+        if (second != NULL) base = first;
+        else UnmapViewOfFile(first);
+    }
+    // the views keep the section alive
+    CloseHandle(mapping);
+#elif _IS_OS_LINUX
+    int fd = (int)syscall(SYS_memfd_create, "arena_ring", MFD_CLOEXEC);
+    if (fd == -1) return false;
+
+    void *reserve = ftruncate(fd, size) == 0 ? _os_virtual_reserve(size * 2) : NULL;
+    if (reserve != NULL) {
+        void *first = mmap(reserve, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+        void *second = mmap((char *)reserve + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+        if (first != MAP_FAILED && second != MAP_FAILED) base = reserve;
+        else munmap(reserve, size * 2);
+    }
+    // the mappings keep the memfd alive
+    close(fd);
+#endif
+    if (base == NULL) return false;
+
+    *ring = (Arena_Ring) {
+        .ptr = (char *)base,
+        .size = size,
+    };
+    return true;
+}
+
+static inline void arena_ring_free(Arena_Ring *ring) {
+    if (ring->ptr != NULL) {
+#if _IS_OS_WINDOWS
+        UnmapViewOfFile(ring->ptr + ring->size);
+        UnmapViewOfFile(ring->ptr);
+#elif _IS_OS_LINUX
+        munmap(ring->ptr, ring->size * 2);
+#endif
+    }
+    *ring = (Arena_Ring) { 0 };
+}
+
+// null when full, that is backpressure, not an error
+static inline void *arena_ring_push_ex(Arena_Ring *ring, size_t size, size_t align) {
+    assert(_is_pow2(align) && align <= _arena_ring_granularity() && "alignment must be a power of 2 up to the granularity");
+
+    // the mapping is only granularity aligned and the size is a multiple of it,
+    // so aligning positions aligns addresses up to the granularity
+    size_t lastPos = _alignup_pow2(ring->head, align);
+    size_t postPos = lastPos + size;
+    if (postPos - ring->tail > ring->size) return NULL;
+
+    ring->head = postPos;
+    return ring->ptr + (lastPos & (ring->size - 1));
+}
+
+static inline size_t arena_ring_get_pos(const Arena_Ring *ring) {
+    return ring->head;
+}
+
+static inline size_t arena_ring_get_used(const Arena_Ring *ring) {
+    return ring->head - ring->tail;
+}
+
+// frees everything pushed before pos, O(1)
+static inline void arena_ring_release_to(Arena_Ring *ring, size_t pos) {
+    assert(pos >= ring->tail && pos <= ring->head && "release position outside the ring");
+    ring->tail = pos;
+}
+
+// frees everything up to the end of a push
+static inline void arena_ring_release(Arena_Ring *ring, const void *ptr, size_t size) {
+    // the end is in (tail, head], measured back from head so a full ring releases too
+    size_t mask = ring->size - 1;
+    size_t end = (size_t)((const char *)ptr - ring->ptr) + size;
+    arena_ring_release_to(ring, ring->head - ((ring->head - end) & mask));
+}
+
+#define arena_ring_push(ring, T, count)     (T *)arena_ring_push_ex(ring, sizeof(T) * (count), _align_of(T))
+
+/*
+ *
+ */
+
+// two stacks in one reservation, the low side grows up from the start, the high side down from the end.
+// positions and commits are counted from each side's own end.
+// the sides meet at a page boundary, so each owns whole pages and commits and decommits them alone
+
+typedef enum Arena_Side {
+    ARENA_SIDE_LOW = 0,
+    ARENA_SIDE_HIGH = 1,
+} Arena_Side;
+
+typedef struct Arena_Dual {
+    char *ptr;
+    size_t reserved;
+    size_t perCommitSize;
+    size_t pos[2];          // per side
+    size_t committed[2];    // per side, page aligned, the ranges never overlap
+
+    // decommit policy for both sides, see arena_dual_set_decommit()
+    size_t decommitThreshold;
+    size_t decommitKeep;
+} Arena_Dual;
+
+typedef struct Arena_Dual_Temp {
+    Arena_Dual *arena;
+    Arena_Side side;
+    size_t pos;
+} Arena_Dual_Temp;
+
+static inline Arena_Dual arena_dual_init(size_t reserveSize, size_t perCommitSize) {
+#if _IS_OS_WINDOWS
+    reserveSize = _alignup_pow2(reserveSize, _os_win32_sysInfo.dwAllocationGranularity);
+#elif _IS_OS_LINUX
+    reserveSize = _alignup_pow2(reserveSize, _os_pageSize);
+#endif
+    void *ptr = _os_virtual_reserve(reserveSize);
+    if (ptr == NULL) return (Arena_Dual) { 0 };
+
+    perCommitSize = perCommitSize < reserveSize ? perCommitSize : reserveSize;
+    perCommitSize = _alignup_pow2(perCommitSize, _os_pageSize);
+
+    return (Arena_Dual) {
+        .ptr = (char *)ptr,
+        .reserved = reserveSize,
+        .perCommitSize = perCommitSize,
+    };
+}
+
+static inline void arena_dual_free(Arena_Dual *arena) {
+    if (arena->ptr != NULL)
+        _os_virtual_release(arena->ptr, arena->reserved);
+    *arena = (Arena_Dual) { 0 };
+}
+
+static inline size_t arena_dual_get_pos(const Arena_Dual *arena, Arena_Side side) {
+    return arena->pos[side];
+}
+
+// address of [from, to) counted from the side's end
+static inline char *_arena_dual_range(const Arena_Dual *arena, Arena_Side side, size_t from, size_t to) {
+    return side == ARENA_SIDE_LOW ? arena->ptr + from : arena->ptr + arena->reserved - to;
+}
+
+// grows the side's committed range to cover postPos, committing only the gap between the sides.
+// pages the other side committed but doesn't use change hands without syscalls
+static bool _arena_dual_commit(Arena_Dual *arena, Arena_Side side, size_t postPos) {
+    Arena_Side other = (Arena_Side)(side ^ 1);
+    size_t limit = arena->reserved - _alignup_pow2(arena->pos[other], _os_pageSize);
+    size_t target = _alignup_pow2(postPos, arena->perCommitSize);
+    target = target < limit ? target : limit;
+
+    size_t gapEnd = arena->reserved - arena->committed[other];
+    size_t commitEnd = target < gapEnd ? target : gapEnd;
+    size_t committed = arena->committed[side];
+    if (commitEnd > committed) {
+        char *ptr = _arena_dual_range(arena, side, committed, commitEnd);
+        if (!_os_virtual_commit(ptr, commitEnd - committed)) return false;
+    }
+
+    if (target > gapEnd) arena->committed[other] = arena->reserved - target;
+    arena->committed[side] = target;
+    return true;
+}
+
+static inline void *arena_dual_push_ex(Arena_Dual *arena, Arena_Side side, size_t size, size_t align) {
+    assert(_is_pow2(align) && "alignment must be non-zero power of 2");
+
+    size_t base = (size_t)arena->ptr;
+    size_t pos = arena->pos[side];
+    size_t lastPos, postPos;
+    if (side == ARENA_SIDE_LOW) {
+        lastPos = _alignup_pow2(base + pos, align) - base;
+        postPos = lastPos + size;
+    } else {
+        // the high side aligns its new low end down
+        size_t top = base + arena->reserved - pos;
+        if (size > top - base) postPos = SIZE_MAX;
+        else postPos = base + arena->reserved - ((top - size) & ~(align - 1));
+        lastPos = postPos - size;
+    }
+
+    Arena_Side other = (Arena_Side)(side ^ 1);
+    size_t otherPos = _alignup_pow2(arena->pos[other], _os_pageSize);
+    if (postPos > arena->reserved - otherPos || _alignup_pow2(postPos, _os_pageSize) > arena->reserved - otherPos) {
+        assert(false && "dual arena sides met");
+        return NULL;
+    }
+
+    if (postPos > arena->committed[side]) {
+        if (!_arena_dual_commit(arena, side, postPos)) return NULL;
+    }
+
+    arena->pos[side] = postPos;
+    return _arena_dual_range(arena, side, lastPos, postPos);
+}
+
+// threshold: decommit on pop when more than this many bytes are committed past a side's pos, 0 disables
+// keep:      bytes kept committed past pos after a decommit, keep < threshold
+static inline void arena_dual_set_decommit(Arena_Dual *arena, size_t threshold, size_t keep) {
+    assert((threshold == 0 || keep < threshold) && "keep must be less than threshold");
+    arena->decommitThreshold = threshold;
+    arena->decommitKeep = keep;
+}
+
+// returns the side's committed pages past pos + keep to the os
+static inline bool arena_dual_decommit(Arena_Dual *arena, Arena_Side side, size_t keep) {
+    size_t keepPos = _alignup_pow2(arena->pos[side] + keep, _os_pageSize);
+    size_t committed = arena->committed[side];
+    if (keepPos >= committed) return true;
+
+    char *ptr = _arena_dual_range(arena, side, keepPos, committed);
+    if (!_os_virtual_decommit(ptr, committed - keepPos)) return false;
+    arena->committed[side] = keepPos;
+    return true;
+}
+
+static inline void arena_dual_pop_to(Arena_Dual *arena, Arena_Side side, size_t to) {
+    assert(arena->pos[side] >= to && "trying to pop forward");
+    arena->pos[side] = to;
+
+    size_t threshold = arena->decommitThreshold;
+    if (threshold != 0 && arena->committed[side] - to > threshold)
+        arena_dual_decommit(arena, side, arena->decommitKeep);
+}
+
+static inline Arena_Dual_Temp arena_dual_temp_begin(Arena_Dual *arena, Arena_Side side) {
+    return (Arena_Dual_Temp) { arena, side, arena->pos[side] };
+}
+static inline void arena_dual_temp_end(Arena_Dual_Temp temp) {
+    arena_dual_pop_to(temp.arena, temp.side, temp.pos);
+}
+
+#define arena_dual_push(arena, side, T, count)  (T *)arena_dual_push_ex(arena, side, sizeof(T) * (count), _align_of(T))
+
+/*
+ *
+ */
+
+struct _Scratch {
+    Arena arena;
+#if ARENA_STATS
+    size_t beginCount;
+#endif
+};
+
+#define PER_THREAD_SCRATCH_COUNT    (ARENA_SCRATCH_COUNT)
+#if ARENA_SCRATCH_RESERVE_SIZE != 0
+#define SCRATCH_RESERVE_SIZE        (ARENA_SCRATCH_RESERVE_SIZE)
+#else
+#define SCRATCH_RESERVE_SIZE        (ARENA_DEFAULT_RESERVE_SIZE)
+#endif
+#if PER_THREAD_SCRATCH_COUNT < 1 || PER_THREAD_SCRATCH_COUNT > 32
+#error scratch count must be in [1, 32]
+#endif
+
+#define _SCRATCH_ALL_MASK   ((uint32_t)(~(uint64_t)0 >> (64 - PER_THREAD_SCRATCH_COUNT)))
+
+// slots are reserved on first use, there are no thread exit hooks in c99,
+// threads call scratches_free() before exiting
+static _THREAD_LOCAL struct _Scratch
+    _scratches[PER_THREAD_SCRATCH_COUNT] = { 0 };
+static _THREAD_LOCAL uint32_t _scratchesInUse = 0;     // bit per slot
+
+// slot of a scratch arena, PER_THREAD_SCRATCH_COUNT for other arenas
+static inline unsigned int _scratch_index(const Arena *arena) {
+    uintptr_t offset = (uintptr_t)arena - (uintptr_t)_scratches;
+    if (offset >= sizeof(_scratches) || offset % sizeof(struct _Scratch) != 0) return PER_THREAD_SCRATCH_COUNT;
+    return (unsigned int)(offset / sizeof(struct _Scratch));
+}
+
+/*
+ *
+ */
+
+static inline Arena_Temp _scratch_begin(Arena *const *conflicts, unsigned int conflictCount, const void *site) {
+    uint32_t conflictMask = 0;
+    for (unsigned int i = 0; i < conflictCount; i++) {
+        unsigned int index = _scratch_index(conflicts[i]);
+        if (index < PER_THREAD_SCRATCH_COUNT) conflictMask |= (uint32_t)1 << index;
+    }
+
+    uint32_t freeMask = ~(_scratchesInUse | conflictMask) & _SCRATCH_ALL_MASK;
+    if (freeMask == 0) {
+        assert(false && "all scratch arenas in use");
+        return (Arena_Temp) { 0 };
+    }
+
+    unsigned int i = _ctz64(freeMask);
+    struct _Scratch *slot = &_scratches[i];
+    if (slot->arena.ptr == NULL) {
+        slot->arena = arena_init_ex(SCRATCH_RESERVE_SIZE, ARENA_DEFAULT_PER_COMMIT_SIZE);
+        if (slot->arena.ptr == NULL) return (Arena_Temp) { 0 };
+    }
+
+    _scratchesInUse |= (uint32_t)1 << i;
+#if ARENA_STATS
+    slot->beginCount++;
+#endif
+    Arena_Temp scratch = { &slot->arena, arena_get_pos(&slot->arena) };
+    _arena_trace(ARENA_TRACE_SCRATCH_BEGIN, scratch.arena, 0, scratch.pos, site);
+    return scratch;
+}
+
+// never returns one of the conflicting arenas, pass the arenas the caller is still pushing into
+_TRACE_ENTRY Arena_Temp scratch_begin_ex(Arena *const *conflicts, unsigned int conflictCount) {
+    return _scratch_begin(conflicts, conflictCount, _trace_site());
+}
+_TRACE_ENTRY Arena_Temp scratch_begin() {
+    return _scratch_begin(NULL, 0, _trace_site());
+}
+_TRACE_ENTRY Arena_Temp scratch_begin_conflict(Arena *conflict) {
+    return _scratch_begin(&conflict, 1, _trace_site());
+}
+
+_TRACE_ENTRY bool scratch_end(Arena_Temp scratch) {
+    unsigned int i = _scratch_index(scratch.arena);
+    if (i >= PER_THREAD_SCRATCH_COUNT) {
+        assert(false && "non-scratch argument passed");
+        return false;
+    }
+
+    _scratchesInUse &= ~((uint32_t)1 << i);
+    arena_pop_to(scratch.arena, scratch.pos);
+    _arena_trace(ARENA_TRACE_SCRATCH_END, scratch.arena, 0, scratch.pos, _trace_site());
+    return true;
+}
+
+// gives committed pages above each scratch's pos back to the OS, the reservations stay.
+// call from threads that go idle after a burst
+static inline void scratches_decommit() {
+    for (unsigned int i = 0; i < PER_THREAD_SCRATCH_COUNT; i++) {
+        if (_scratches[i].arena.ptr != NULL)
+            arena_decommit(&_scratches[i].arena, 0);
+    }
 }
 
 static inline void scratches_free() {
-    if (_scratches[0].arena.ptr != NULL) {
-        for (unsigned int i = 0; i < PER_THREAD_SCRATCH_COUNT; i++) {
+    for (unsigned int i = 0; i < PER_THREAD_SCRATCH_COUNT; i++) {
+        if (_scratches[i].arena.ptr != NULL)
             arena_free(&_scratches[i].arena);
-            _scratches[i].inUse = false;
-        }
+    }
+    _scratchesInUse = 0;
+}
+
+#if ARENA_STATS
+
+static inline const Arena_Stats *arena_get_stats(const Arena *arena) {
+    return &arena->stats;
+}
+
+static inline void arena_stats_dump(const Arena *arena, FILE *file) {
+    const Arena_Stats *stats = &arena->stats;
+    fprintf(file, "arena %p: pos %zu, peak pos %zu, committed %zu, reserved %zu, per commit %zu\n",
+        arena->ptr, arena_get_pos(arena), stats->peakPos, arena->committed, arena->reserved, arena->perCommitSize);
+    fprintf(file, "  commits: %zu (%zu bytes), decommits: %zu (%zu bytes)\n",
+        stats->commitCount, stats->commitBytes, stats->decommitCount, stats->decommitBytes);
+    fprintf(file, "  pushes: %zu, alignment padding: %zu bytes\n",
+        stats->pushCount, stats->paddingBytes);
+
+    for (unsigned int i = 0; i < ARENA_STATS_BUCKET_COUNT; i++) {
+        if (stats->pushBuckets[i] == 0) continue;
+        if (i + 1 < ARENA_STATS_BUCKET_COUNT)
+            fprintf(file, "  size [%zu, %zu): %zu\n", (size_t)1 << i, (size_t)1 << (i + 1), stats->pushBuckets[i]);
+        else
+            fprintf(file, "  size [%zu, ...): %zu\n", (size_t)1 << i, stats->pushBuckets[i]);
+    }
+}
+
+// current thread's scratches
+static inline void scratches_stats_dump(FILE *file) {
+    for (unsigned int i = 0; i < PER_THREAD_SCRATCH_COUNT; i++) {
+        if (_scratches[i].arena.ptr == NULL) continue;
+        fprintf(file, "scratch %u: begins %zu, in use %d\n", i, _scratches[i].beginCount, (int)(_scratchesInUse >> i & 1));
+        arena_stats_dump(&_scratches[i].arena, file);
     }
 }
 
+#endif  // ARENA_STATS
+
 /*
  *
  */
 
-// TODO: bitmap allocator
+// fixed size object pool, slabs are carved out of an arena
 // https://medium.com/@tom_84912/object-allocators-%E1%B4%99-us-dc0edda80c58
 
+#define POOL_DEFAULT_SLAB_SIZE  (kilobytes(64))
+
+typedef struct _Pool_Slab {
+    struct _Pool_Slab *nextFree;    // next slab with free slots
+    size_t freeCount;
+    size_t hint;                    // lowest bitmap word that may have a free slot
+    // uint64_t bitmap[wordCount], set bit means slot in use
+    // slots start at slotsOffset
+} _Pool_Slab;
+
+typedef struct Pool {
+    Arena *arena;
+    _Pool_Slab *freeSlabs;
+    size_t slotSize;
+    size_t slotCount;       // per slab
+    size_t slotsOffset;
+    size_t wordCount;
+    size_t slabSize;
+} Pool;
+
+// slabs are aligned to slabSize, so freeing finds its slab with a mask.
+// slabs live until the arena pops below them, pool must not outlive that
+static inline Pool pool_init_ex(Arena *arena, size_t size, size_t align, size_t slabSize) {
+    assert(_is_pow2(align) && "alignment must be non-zero power of 2");
+    assert(_is_pow2(slabSize) && "slab size must be power of 2");
+
+    size_t slotSize = _alignup_pow2(size != 0 ? size : 1, align);
+    size_t header = sizeof(_Pool_Slab);
+
+    // every slot costs slotSize bytes and 1 bit
+    size_t slotCount = (slabSize - header) * 8 / (slotSize * 8 + 1);
+    size_t wordCount, slotsOffset;
+    for (;;) {
+        wordCount = (slotCount + 63) / 64;
+        slotsOffset = _alignup_pow2(header + wordCount * sizeof(uint64_t), align);
+        if (slotsOffset + slotCount * slotSize <= slabSize) break;
+        slotCount--;
+    }
+    assert(slotCount != 0 && "slab size too small for the object");
+
+    return (Pool) {
+        .arena = arena,
+        .slotSize = slotSize,
+        .slotCount = slotCount,
+        .slotsOffset = slotsOffset,
+        .wordCount = wordCount,
+        .slabSize = slabSize,
+    };
+}
+
+static inline _Pool_Slab *_pool_slab_new(Pool *pool) {
+    void *ptr = arena_push_ex(pool->arena, pool->slabSize, pool->slabSize);
+    if (ptr == NULL) return NULL;
+
+    _Pool_Slab *slab = (_Pool_Slab *)ptr;
+    slab->nextFree = NULL;
+    slab->freeCount = pool->slotCount;
+    slab->hint = 0;
+
+    // memory may be reused after a pop, clear explicitly
+    uint64_t *bitmap = (uint64_t *)(slab + 1);
+    for (size_t i = 0; i < pool->wordCount; i++)
+        bitmap[i] = 0;
+
+    // mark the tail of the last word as used, scans never pick them
+    size_t tail = pool->slotCount % 64;
+    if (tail != 0)
+        bitmap[pool->wordCount - 1] = ~0ull << tail;
+
+    pool->freeSlabs = slab;
+    return slab;
+}
+
+// returned memory is not zeroed
+static inline void *pool_alloc_ex(Pool *pool) {
+    _Pool_Slab *slab = pool->freeSlabs;
+    if (slab == NULL) {
+        slab = _pool_slab_new(pool);
+        if (slab == NULL) return NULL;
+    }
+
+    // freeCount != 0, a free bit exists at or after the hint
+    uint64_t *bitmap = (uint64_t *)(slab + 1);
+    size_t word = slab->hint;
+    while (bitmap[word] == ~0ull)
+        word++;
+    unsigned int bit = _ctz64(~bitmap[word]);
+    bitmap[word] |= 1ull << bit;
+    slab->hint = word;
+
+    if (--slab->freeCount == 0) {
+        pool->freeSlabs = slab->nextFree;
+        slab->nextFree = NULL;
+    }
+
+    size_t slot = word * 64 + bit;
+    return (char *)slab + pool->slotsOffset + slot * pool->slotSize;
+}
+
+static inline void pool_free(Pool *pool, void *ptr) {
+    if (ptr == NULL) return;
+
+    size_t addr = (size_t)ptr;
+    _Pool_Slab *slab = (_Pool_Slab *)(addr & ~(pool->slabSize - 1));
+
+    size_t slot = (addr - (size_t)slab - pool->slotsOffset) / pool->slotSize;
+    size_t word = slot / 64;
+    uint64_t mask = 1ull << (slot % 64);
+
+    uint64_t *bitmap = (uint64_t *)(slab + 1);
+    assert((bitmap[word] & mask) != 0 && "double free");
+    bitmap[word] &= ~mask;
+    if (word < slab->hint) slab->hint = word;
+
+    // full slabs are not listed, relink on first free
+    if (slab->freeCount++ == 0) {
+        slab->nextFree = pool->freeSlabs;
+        pool->freeSlabs = slab;
+    }
+}
+
+#define pool_init(arena, T) pool_init_ex(arena, sizeof(T), _align_of(T), POOL_DEFAULT_SLAB_SIZE)
+#define pool_alloc(pool, T) (T *)pool_alloc_ex(pool)
+
+/*
+ *
+ */
+
+// growable array, grows in place while it is the last push
+typedef struct Arena_Array {
+    Arena *arena;
+    void *ptr;
+    size_t len;
+    size_t cap;
+    size_t elemSize;
+    size_t align;
+} Arena_Array;
+
+static inline bool arena_array_reserve(Arena_Array *array, size_t cap) {
+    if (cap <= array->cap) return true;
+
+    size_t newCap = array->cap * 2;
+    newCap = newCap > cap ? newCap : cap;
+
+    void *ptr = arena_realloc(
+        array->arena, array->ptr,
+        array->elemSize * array->cap, array->elemSize * newCap, array->align
+    );
+    if (ptr == NULL) return false;
+
+    array->ptr = ptr;
+    array->cap = newCap;
+    return true;
+}
+
+static inline Arena_Array arena_array_init_ex(Arena *arena, size_t elemSize, size_t align, size_t cap) {
+    Arena_Array res = { arena, NULL, 0, 0, elemSize, align };
+    if (cap != 0) arena_array_reserve(&res, cap);
+    return res;
+}
+
+// returns the first of count new elements, not zeroed
+static inline void *arena_array_push_ex(Arena_Array *array, size_t count) {
+    if (!arena_array_reserve(array, array->len + count)) return NULL;
+
+    void *res = (char *)array->ptr + array->elemSize * array->len;
+    array->len += count;
+    return res;
+}
+
+static inline void arena_array_pop(Arena_Array *array, size_t count) {
+    assert(array->len >= count && "popping more than the array has");
+    array->len -= count;
+}
+
+// gives unused capacity back when the array is the last push
+static inline void arena_array_fit(Arena_Array *array) {
+    if (arena_extend(array->arena, array->ptr, array->elemSize * array->cap, array->elemSize * array->len))
+        array->cap = array->len;
+}
+
+#define arena_array_init(arena, T)          arena_array_init_ex(arena, sizeof(T), _align_of(T), 0)
+#define arena_array_push(array, T)          (T *)arena_array_push_ex(array, 1)
+#define arena_array_at(array, T, index)     (((T *)(array)->ptr)[index])
+
+/*
+ *
+ */
+
+// position independent data, stays valid when the arena image is copied,
+// mapped at another address (arena_file_open) or shared between processes.
+// base relative offsets need the arena, self relative pointers only themselves
+
+static inline size_t arena_offset_of(const Arena *arena, const void *ptr) {
+    assert(arena->prev == NULL && "chained arenas aren't one image");
+    return (size_t)((const char *)ptr - (const char *)arena->ptr);
+}
+
+#define arena_ptr_at(arena, T, offset)  (T *)((char *)(arena)->ptr + (offset))
+
+// offset from its own address, 0 is null.
+// copying one with memcpy breaks it unless its target moves by the same amount,
+// assign through rel_ptr_set() instead
+typedef struct Rel_Ptr {
+    intptr_t offset;
+} Rel_Ptr;
+
+static inline void *_rel_ptr_get(const Rel_Ptr *rel) {
+    if (rel->offset == 0) return NULL;
+    return (void *)((intptr_t)rel + rel->offset);
+}
+
+static inline void rel_ptr_set(Rel_Ptr *rel, const void *ptr) {
+    rel->offset = ptr != NULL ? (intptr_t)ptr - (intptr_t)rel : 0;
+}
+
+#define rel_ptr_get(rel, T) ((T *)_rel_ptr_get(rel))
+
+typedef struct Rel_Str {
+    Rel_Ptr ptr;
+    size_t len;
+} Rel_Str;
+
+static inline Arena_Str rel_str_get(const Rel_Str *str) {
+    return (Arena_Str) { (char *)_rel_ptr_get(&str->ptr), str->len };
+}
+
+// points at str, which must live in the same image
+static inline void rel_str_set(Rel_Str *dst, Arena_Str str) {
+    rel_ptr_set(&dst->ptr, str.ptr);
+    dst->len = str.len;
+}
+
 #endif  // _ARENA_H
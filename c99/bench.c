@@ -0,0 +1,358 @@
+// gcc -std=gnu99 -O2 -pthread bench.c -o bench
+// prints one json object per line
+
+#include "arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if _IS_OS_WINDOWS
+typedef HANDLE Bench_Thread;
+#elif _IS_OS_LINUX
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <time.h>
+typedef pthread_t Bench_Thread;
+#endif
+
+static void *volatile benchSink;
+
+static double now_ns(void) {
+#if _IS_OS_WINDOWS
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart * 1e9 / (double)freq.QuadPart;
+#elif _IS_OS_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+static void report(
+    const char *bench, const char *variant,
+    size_t size, size_t align, unsigned int threads, size_t ops, double ns
+) {
+    printf(
+        "{\"suite\":\"c99\",\"bench\":\"%s\",\"variant\":\"%s\",\"size\":%zu,\"align\":%zu,"
+        "\"threads\":%u,\"ops\":%zu,\"ns_per_op\":%.3f}\n",
+        bench, variant, size, align, threads, ops, ns / ops
+    );
+}
+
+#if _IS_OS_LINUX
+
+// user space instructions retired, -1 when perf events are unavailable
+static int counter_open(void) {
+    struct perf_event_attr attr = {
+        .type = PERF_TYPE_HARDWARE,
+        .size = sizeof(attr),
+        .config = PERF_COUNT_HW_INSTRUCTIONS,
+        .disabled = 1,
+        .exclude_kernel = 1,
+        .exclude_hv = 1,
+    };
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void counter_start(int fd) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+// skips the report when the count can't be read
+static void counter_report(int fd, const char *bench, const char *variant, size_t size, size_t ops) {
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t count = 0;
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) return;
+    printf(
+        "{\"suite\":\"c99\",\"bench\":\"%s\",\"variant\":\"%s\",\"size\":%zu,"
+        "\"ops\":%zu,\"instructions_per_op\":%.3f}\n",
+        bench, variant, size, ops, (double)count / ops
+    );
+}
+
+#endif
+
+/*
+ *
+ */
+
+#define PUSH_OPS    ((size_t)1 << 20)
+#define PUSH_BYTES  (megabytes(256))
+
+static void bench_push(size_t size, size_t align) {
+    size_t ops = PUSH_BYTES / (size + align);
+    ops = ops < PUSH_OPS ? ops : PUSH_OPS;
+
+    Arena arena = arena_init_ex(PUSH_BYTES, ARENA_DEFAULT_PER_COMMIT_SIZE);
+    // warm up the commits, only the bump is measured
+    arena_push_ex(&arena, (size + align) * ops, 1);
+    arena_pop_to(&arena, 0);
+
+    double t0 = now_ns();
+    for (size_t i = 0; i < ops; i++)
+        benchSink = arena_push_ex(&arena, size, align);
+    report("push", "arena", size, align, 1, ops, now_ns() - t0);
+    arena_pop_to(&arena, 0);
+
+    t0 = now_ns();
+    Arena_Cursor cursor = arena_cursor_begin(&arena, (size + align) * ops);
+    for (size_t i = 0; i < ops; i++)
+        benchSink = arena_cursor_push_ex(&cursor, size, align);
+    arena_cursor_end(cursor);
+    report("push", "cursor", size, align, 1, ops, now_ns() - t0);
+    arena_free(&arena);
+
+    // malloc then free in the same order
+    void **ptrs = malloc(sizeof(void *) * ops);
+    t0 = now_ns();
+    for (size_t i = 0; i < ops; i++)
+        ptrs[i] = malloc(size);
+    for (size_t i = 0; i < ops; i++)
+        free(ptrs[i]);
+    report("push", "malloc_batch", size, align, 1, ops, now_ns() - t0);
+    free(ptrs);
+
+    // size class free list reuse, the common case jemalloc/tcmalloc optimize for
+    t0 = now_ns();
+    for (size_t i = 0; i < ops; i++) {
+        void *ptr = malloc(size);
+        benchSink = ptr;
+        free(ptr);
+    }
+    report("push", "malloc_pair", size, align, 1, ops, now_ns() - t0);
+}
+
+#if _IS_OS_LINUX
+
+// the push before the hot/cold split, the baseline for the arena variant
+__attribute__((always_inline)) static inline void *push_unsplit(Arena *arena, size_t size, size_t align) {
+    size_t base = (size_t)arena->ptr;
+    size_t lastPos = _alignup_pow2(base + arena->pos, align) - base;
+    size_t postPos = lastPos + size;
+
+    if (postPos > arena->committed)
+        return _arena_push_commit(arena, size, align, lastPos, postPos, NULL);
+    return _arena_push_bump(arena, size, lastPos, postPos, NULL);
+}
+
+// flatten pulls the commit path into the loop, as the unsplit push did at every call site
+__attribute__((flatten)) static void push_loop_unsplit(Arena *arena, size_t size, size_t ops) {
+    for (size_t i = 0; i < ops; i++)
+        benchSink = push_unsplit(arena, size, 8);
+}
+
+// the push fast path inlines to a compare and a bump, the commit path stays out of line
+static void bench_push_instructions(int fd, size_t size) {
+    size_t ops = PUSH_OPS;
+    Arena arena = arena_init_ex(size * ops, ARENA_DEFAULT_PER_COMMIT_SIZE);
+
+    // includes the commits, user space side only
+    counter_start(fd);
+    for (size_t i = 0; i < ops; i++)
+        benchSink = arena_push_ex(&arena, size, 8);
+    counter_report(fd, "push_instructions", "arena_growth", size, ops);
+    arena_pop_to(&arena, 0);
+
+    counter_start(fd);
+    for (size_t i = 0; i < ops; i++)
+        benchSink = arena_push_ex(&arena, size, 8);
+    counter_report(fd, "push_instructions", "arena", size, ops);
+    arena_pop_to(&arena, 0);
+
+    counter_start(fd);
+    push_loop_unsplit(&arena, size, ops);
+    counter_report(fd, "push_instructions", "arena_unsplit", size, ops);
+    arena_pop_to(&arena, 0);
+
+    counter_start(fd);
+    Arena_Cursor cursor = arena_cursor_begin(&arena, size * ops);
+    for (size_t i = 0; i < ops; i++)
+        benchSink = arena_cursor_push_ex(&cursor, size, 8);
+    arena_cursor_end(cursor);
+    counter_report(fd, "push_instructions", "cursor", size, ops);
+    arena_free(&arena);
+
+    counter_start(fd);
+    for (size_t i = 0; i < ops; i++) {
+        void *ptr = malloc(size);
+        benchSink = ptr;
+        free(ptr);
+    }
+    counter_report(fd, "push_instructions", "malloc_pair", size, ops);
+}
+
+#endif
+
+#define TEMP_OPS    ((size_t)1 << 22)
+
+static void bench_temp(void) {
+    Arena arena = arena_init();
+
+    double t0 = now_ns();
+    for (size_t i = 0; i < TEMP_OPS; i++) {
+        Arena_Temp temp = arena_temp_begin(&arena);
+        benchSink = arena_push(&arena, char, 64);
+        arena_temp_end(temp);
+    }
+    report("temp_round_trip", "arena", 64, 1, 1, TEMP_OPS, now_ns() - t0);
+    arena_free(&arena);
+
+    t0 = now_ns();
+    for (size_t i = 0; i < TEMP_OPS; i++) {
+        Arena_Temp scratch = scratch_begin();
+        benchSink = arena_push(scratch.arena, char, 64);
+        scratch_end(scratch);
+    }
+    report("scratch_round_trip", "arena", 64, 1, 1, TEMP_OPS, now_ns() - t0);
+    scratches_free();
+
+    t0 = now_ns();
+    for (size_t i = 0; i < TEMP_OPS; i++) {
+        void *ptr = malloc(64);
+        benchSink = ptr;
+        free(ptr);
+    }
+    report("scratch_round_trip", "malloc", 64, 1, 1, TEMP_OPS, now_ns() - t0);
+}
+
+#define FILL_SIZE   (megabytes(64))
+
+static double fill_arena(size_t perCommitSize, unsigned int flags) {
+    Arena arena = arena_init_flags(FILL_SIZE, perCommitSize, flags);
+    size_t ops = FILL_SIZE / 64;
+
+    double t0 = now_ns();
+    for (size_t i = 0; i < ops; i++) {
+        char *ptr = arena_push(&arena, char, 64);
+        ptr[0] = 1;     // touch, page faults are part of growth
+    }
+    double ns = now_ns() - t0;
+    arena_free(&arena);
+    return ns;
+}
+
+static void bench_commit_growth(void) {
+    const size_t perCommitSizes[] = { kilobytes(4), kilobytes(8), kilobytes(64), megabytes(1), megabytes(2) };
+    for (size_t i = 0; i < sizeof(perCommitSizes) / sizeof(perCommitSizes[0]); i++) {
+        report("commit_growth", "arena", perCommitSizes[i], 1, 1, FILL_SIZE / 64, fill_arena(perCommitSizes[i], 0));
+        // no mprotect per commit step, only the page faults remain
+        double ns = fill_arena(perCommitSizes[i], ARENA_FLAG_DEMAND_PAGED);
+        report("commit_growth", "arena_demand", perCommitSizes[i], 1, 1, FILL_SIZE / 64, ns);
+    }
+}
+
+#define THREAD_OPS  ((size_t)1 << 20)
+#define MAX_THREADS (64)
+
+#if _IS_OS_WINDOWS
+#define BENCH_THREAD_FN(name)   static DWORD WINAPI name(void *arg)
+#define BENCH_THREAD_RET        0
+#elif _IS_OS_LINUX
+#define BENCH_THREAD_FN(name)   static void *name(void *arg)
+#define BENCH_THREAD_RET        NULL
+#endif
+
+BENCH_THREAD_FN(thread_scratch) {
+    (void)arg;
+    for (size_t i = 0; i < THREAD_OPS; i++) {
+        Arena_Temp scratch = scratch_begin();
+        for (int j = 0; j < 8; j++)
+            benchSink = arena_push(scratch.arena, char, 48);
+        scratch_end(scratch);
+    }
+    scratches_free();
+    return BENCH_THREAD_RET;
+}
+
+BENCH_THREAD_FN(thread_malloc) {
+    (void)arg;
+    void *ptrs[8];
+    for (size_t i = 0; i < THREAD_OPS; i++) {
+        for (int j = 0; j < 8; j++)
+            ptrs[j] = malloc(48);
+        for (int j = 0; j < 8; j++)
+            free(ptrs[j]);
+    }
+    return BENCH_THREAD_RET;
+}
+
+BENCH_THREAD_FN(thread_fill) {
+    unsigned int flags = *(unsigned int *)arg;
+    fill_arena(ARENA_DEFAULT_PER_COMMIT_SIZE, flags);
+    return BENCH_THREAD_RET;
+}
+
+#if _IS_OS_WINDOWS
+static double run_threads(unsigned int threadCount, LPTHREAD_START_ROUTINE fn, void *arg) {
+    Bench_Thread threads[MAX_THREADS];
+    double t0 = now_ns();
+    for (unsigned int i = 0; i < threadCount; i++)
+        threads[i] = CreateThread(NULL, 0, fn, arg, 0, NULL);
+    for (unsigned int i = 0; i < threadCount; i++) {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+    return now_ns() - t0;
+}
+#elif _IS_OS_LINUX
+static double run_threads(unsigned int threadCount, void *(*fn)(void *), void *arg) {
+    Bench_Thread threads[MAX_THREADS];
+    double t0 = now_ns();
+    for (unsigned int i = 0; i < threadCount; i++)
+        pthread_create(&threads[i], NULL, fn, arg);
+    for (unsigned int i = 0; i < threadCount; i++)
+        pthread_join(threads[i], NULL);
+    return now_ns() - t0;
+}
+#endif
+
+static void bench_threads(unsigned int threadCount) {
+    double ns = run_threads(threadCount, thread_scratch, NULL);
+    report("threaded_scratch", "arena", 48, 1, threadCount, THREAD_OPS * 8 * threadCount, ns);
+
+    ns = run_threads(threadCount, thread_malloc, NULL);
+    report("threaded_scratch", "malloc", 48, 1, threadCount, THREAD_OPS * 8 * threadCount, ns);
+
+    // commit syscalls contend on the process wide mmap lock
+    unsigned int flags = 0;
+    ns = run_threads(threadCount, thread_fill, &flags);
+    report("threaded_commit_growth", "arena", ARENA_DEFAULT_PER_COMMIT_SIZE, 1, threadCount, FILL_SIZE / 64 * threadCount, ns);
+
+    flags = ARENA_FLAG_DEMAND_PAGED;
+    ns = run_threads(threadCount, thread_fill, &flags);
+    report("threaded_commit_growth", "arena_demand", ARENA_DEFAULT_PER_COMMIT_SIZE, 1, threadCount, FILL_SIZE / 64 * threadCount, ns);
+}
+
+int main(void) {
+    const size_t sizes[] = { 8, 16, 64, 256, 4096 };
+    const size_t aligns[] = { 1, 8, 64 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        for (size_t j = 0; j < sizeof(aligns) / sizeof(aligns[0]); j++)
+            bench_push(sizes[i], aligns[j]);
+
+#if _IS_OS_LINUX
+    int fd = counter_open();
+    if (fd >= 0) {
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+            bench_push_instructions(fd, sizes[i]);
+        close(fd);
+    }
+#endif
+
+    bench_temp();
+    bench_commit_growth();
+
+#if _IS_OS_WINDOWS
+    unsigned int threadCount = _os_win32_sysInfo.dwNumberOfProcessors;
+#elif _IS_OS_LINUX
+    unsigned int threadCount = (unsigned int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    threadCount = threadCount < MAX_THREADS ? threadCount : MAX_THREADS;
+    bench_threads(1);
+    if (threadCount > 1) bench_threads(threadCount);
+    return 0;
+}
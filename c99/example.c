@@ -3,56 +3,15 @@
 #include <stdio.h>
 #include <stdarg.h>
 
-const char *cstr_fmtva(Arena *arena, const char *fmt, va_list args) {
-    va_list copyArgs;
-    va_copy(copyArgs, args);
-
-    int bytes = vsnprintf(0, 0, fmt, args);
-    if (bytes < 0) {    // bytes == 0: "" is valid string in c
-        assert(false && "vsnprintf(): failed");
-        va_end(copyArgs);
-        return NULL;
-    }
-
-    Arena_Temp arenaState = arena_temp_begin(arena);
-
-    size_t neededBytes = bytes + 1ull;
-    char *ptr = arena_push(arena, char, neededBytes);
-    if (ptr == NULL) {
-        va_end(copyArgs);
-        return NULL;
-    }
-
-    int len = vsnprintf(ptr, neededBytes, fmt, copyArgs);
-    va_end(copyArgs);
-
-    if (len < 0) {
-        arena_temp_end(arenaState);
-
-        assert(false && "vsnprintf(): failed");
-        return NULL;
-    }
-
-    return ptr;
-}
-
-const char *cstr_fmt(Arena *arena, const char *fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-    const char *res = cstr_fmtva(arena, fmt, args);
-    va_end(args);
-    return res;
-}
-
 void tprintln_fmt(const char *fmt, ...) {
     Arena_Temp scratch = scratch_begin();
 
     va_list args;
     va_start(args, fmt);
-    const char *ptr = cstr_fmtva(scratch.arena, fmt, args);
+    Arena_Str str = arena_str_fmtva(scratch.arena, fmt, args);
     va_end(args);
 
-    puts(ptr);
+    puts(str.ptr);
 
     scratch_end(scratch);
 }
@@ -61,8 +20,9 @@ int main() {
     Arena arena = arena_init_ex(gigabytes(256), kilobytes(8));
     // Arena arena = arena_init();
 
-    const char *cStr = cstr_fmt(&arena, "This is a test: \t%d", 46);
-    puts(cStr);
+    Arena_Str str = arena_str_fmt(&arena, "This is a test: \t%d", 46);
+    str = arena_str_append_fmt(&arena, str, ", appended in place: %s", "yes");
+    puts(str.ptr);
 
     arena_free(&arena);
 
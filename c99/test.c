@@ -0,0 +1,225 @@
+// gcc -std=gnu99 -pthread test.c -o test
+// prints each failed check, exits non-zero when any failed
+
+#include "arena.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int failedChecks = 0;
+
+static bool _check_failed(const char *expr, const char *file, int line) {
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+    failedChecks++;
+    return false;
+}
+
+// not assert, so it still checks under NDEBUG. false on failure
+#define check(cond)     ((cond) ? true : _check_failed(#cond, __FILE__, __LINE__))
+
+static bool is_zero(const char *ptr, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        if (ptr[i] != 0) return false;
+    }
+    return true;
+}
+
+static void test_ring_align(void) {
+    Arena_Ring ring = { 0 };
+    if (!check(arena_ring_init(&ring, megabytes(1)))) return;
+
+    size_t granularity = _arena_ring_granularity();
+    for (int i = 0; i < 64; i++) {
+        check(arena_ring_push(&ring, char, 100) != NULL);
+        char *ptr = (char *)arena_ring_push_ex(&ring, 100, granularity);
+        check(ptr != NULL && (size_t)ptr % granularity == 0);
+        arena_ring_release_to(&ring, arena_ring_get_pos(&ring));
+    }
+    arena_ring_free(&ring);
+}
+
+static void test_chained_pop(void) {
+    Arena arena = arena_init_flags(kilobytes(64), kilobytes(4), ARENA_FLAG_CHAINED);
+    if (!check(arena.ptr != NULL)) return;
+
+    char *first = arena_push(&arena, char, kilobytes(40));
+    if (!check(first != NULL)) return;
+    memset(first, 1, kilobytes(40));
+    size_t mark = arena_get_pos(&arena);
+
+    // each push past the first block starts a new one
+    for (int i = 0; i < 4; i++) {
+        char *ptr = arena_push(&arena, char, kilobytes(40));
+        if (!check(ptr != NULL)) return;
+        memset(ptr, 2, kilobytes(40));
+    }
+    check(arena.prev != NULL);
+    check(arena_get_pos(&arena) == mark + kilobytes(4 * 40));
+
+    // back into the first block, its contents survive
+    arena_pop_to(&arena, kilobytes(20));
+    check(arena.prev == NULL);
+    check(arena_get_pos(&arena) == kilobytes(20));
+    check(first[0] == 1 && first[kilobytes(20) - 1] == 1);
+
+    char *next = arena_push(&arena, char, 16);
+    check(next == first + kilobytes(20));
+
+    arena_pop_to(&arena, 0);
+    check(arena_get_pos(&arena) == 0);
+    arena_free(&arena);
+}
+
+static void test_push_zero_reuse(void) {
+    Arena arena = arena_init_ex(megabytes(1), kilobytes(64));
+    if (!check(arena.ptr != NULL)) return;
+
+    char *dirty = arena_push_nozero(&arena, char, kilobytes(100));
+    if (!check(dirty != NULL)) return;
+    memset(dirty, 0xff, kilobytes(100));
+
+    // popped bytes are handed out again, push_zero must clear them
+    arena_pop_to(&arena, kilobytes(10));
+    char *zero = arena_push_zero(&arena, char, kilobytes(50));
+    check(zero == dirty + kilobytes(10));
+    check(zero != NULL && is_zero(zero, kilobytes(50)));
+
+    arena_pop_to(&arena, 0);
+    zero = arena_push_zero(&arena, char, kilobytes(200));
+    check(zero != NULL && is_zero(zero, kilobytes(200)));
+    arena_free(&arena);
+}
+
+typedef struct Shared_Filler {
+    Arena_Shared *arena;
+    size_t count;
+} Shared_Filler;
+
+static void *shared_fill(void *arg) {
+    Shared_Filler *filler = (Shared_Filler *)arg;
+    while (arena_shared_push(filler->arena, char, ARENA_SHARED_GRAIN) != NULL)
+        filler->count++;
+    return NULL;
+}
+
+static void test_shared_overflow(void) {
+    Arena_Shared arena;
+    if (!check(arena_shared_init(&arena, kilobytes(64), kilobytes(16), 0))) return;
+
+    // a push that doesn't fit fails without moving pos, smaller ones still fit
+    check(arena_shared_push(&arena, char, kilobytes(60)) != NULL);
+    check(arena_shared_push(&arena, char, kilobytes(8)) == NULL);
+    check(arena_shared_get_pos(&arena) == kilobytes(60));
+    check(arena_shared_push(&arena, char, kilobytes(4)) != NULL);
+    check(arena_shared_get_pos(&arena) == kilobytes(64));
+    check(arena_shared_push(&arena, char, 1) == NULL);
+
+    // threads racing to the end fill the reservation exactly
+    arena_shared_pop_to(&arena, 0);
+    Shared_Filler fillers[4];
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++) {
+        fillers[i] = (Shared_Filler) { .arena = &arena, .count = 0 };
+        pthread_create(&threads[i], NULL, shared_fill, &fillers[i]);
+    }
+    size_t count = 0;
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+        count += fillers[i].count;
+    }
+    check(count == kilobytes(64) / ARENA_SHARED_GRAIN);
+    check(arena_shared_get_pos(&arena) == kilobytes(64));
+    arena_shared_free(&arena);
+}
+
+#if defined(NDEBUG)
+
+// an overflowing push asserts otherwise
+static void test_fmt_overflow_push_zero(void) {
+    Arena arena = arena_init_ex(kilobytes(64), kilobytes(64));
+    if (!check(arena.ptr != NULL && arena_push(&arena, char, 16) != NULL)) return;
+    arena_pop_to(&arena, 0);
+
+    // fills the committed tail, then fails to push past the reserve
+    size_t len = kilobytes(100);
+    char *big = (char *)malloc(len + 1);
+    memset(big, 'x', len);
+    big[len] = '\0';
+    check(arena_str_fmt(&arena, "%s", big).ptr == NULL);
+    check(arena_get_pos(&arena) == 0);
+    free(big);
+
+    char *zero = arena_push_zero(&arena, char, kilobytes(64));
+    check(zero != NULL && is_zero(zero, kilobytes(64)));
+    arena_free(&arena);
+}
+
+#endif
+
+#if _IS_OS_LINUX
+
+static void test_shm_overflow(void) {
+    Arena_Shm arena;
+    if (!check(arena_shm_create(&arena, NULL, kilobytes(64), kilobytes(16)))) return;
+
+    // as with Arena_Shared, a failed push leaves pos within the reservation
+    check(arena_shm_push(&arena, char, kilobytes(60)) != NULL);
+    check(arena_shm_push(&arena, char, kilobytes(8)) == NULL);
+    check(arena_shm_get_pos(&arena) == kilobytes(60));
+    check(arena_shm_push(&arena, char, kilobytes(4)) != NULL);
+    check(arena_shm_get_pos(&arena) == kilobytes(64));
+    arena_shm_close(&arena);
+}
+
+static void test_file_read_only(void) {
+    char path[] = "/tmp/arena_test_XXXXXX";
+    int fd = mkstemp(path);
+    if (!check(fd != -1)) return;
+    close(fd);
+
+    Arena arena = arena_file_create(path, megabytes(1), ARENA_DEFAULT_PER_COMMIT_SIZE);
+    Arena_Str str = arena_str_fmt(&arena, "saved %d", 1);
+    check(str.ptr != NULL);
+    check(arena_file_save(&arena));
+    arena_free(&arena);
+
+    arena = arena_file_open(path, ARENA_FILE_READ_ONLY);
+    if (!check(arena.ptr != NULL)) return;
+    str = (Arena_Str) { .ptr = (char *)arena.ptr, .len = 7 };
+    check(strcmp(str.ptr, "saved 1") == 0);
+
+    size_t pos = arena_get_pos(&arena);
+    check(arena_push(&arena, char, 1) == NULL);
+    check(arena_str_fmt(&arena, "%d", 2).ptr == NULL);
+    check(arena_str_append(&arena, str, "x", 1).ptr == NULL);
+    check(arena_get_pos(&arena) == pos);
+
+    // room below the old pos is still read-only
+    arena_pop_to(&arena, 0);
+    check(arena_push(&arena, char, 1) == NULL);
+    arena_free(&arena);
+    unlink(path);
+}
+
+#endif
+
+int main(void) {
+    test_ring_align();
+    test_chained_pop();
+    test_push_zero_reuse();
+    test_shared_overflow();
+#if defined(NDEBUG)
+    test_fmt_overflow_push_zero();
+#endif
+#if _IS_OS_LINUX
+    test_shm_overflow();
+    test_file_read_only();
+#endif
+    if (failedChecks != 0) {
+        fprintf(stderr, "%d checks failed\n", failedChecks);
+        return 1;
+    }
+    puts("ok");
+    return 0;
+}
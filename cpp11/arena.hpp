@@ -27,16 +27,85 @@
 #error arch not supported!
 #endif
 
+#if _IS_COMPILER_MSVC
+#define _CPP_VERSION        _MSVC_LANG
+#else
+#define _CPP_VERSION        __cplusplus
+#endif
+
+// build options
+#if !defined(ARENA_STATS)
+#define ARENA_STATS         0   // collect Arena_Stats, see arena_stats_dump()
+#endif
+#if !defined(ARENA_TRACE)
+#define ARENA_TRACE         0   // record push/temp/scratch events, see arena_trace_export()
+#endif
+#if !defined(ARENA_PREFAULT_THREAD)
+#define ARENA_PREFAULT_THREAD   0   // populate arena_set_prefault() windows on a helper thread
+#endif
+#if !defined(ARENA_SCRATCH_COUNT)
+#define ARENA_SCRATCH_COUNT 4   // scratch arenas per thread, at most 32
+#endif
+#if !defined(ARENA_SCRATCH_RESERVE_SIZE)
+#define ARENA_SCRATCH_RESERVE_SIZE  0   // per scratch arena, 0 is ARENA_DEFAULT_RESERVE_SIZE
+#endif
+
 /*
  *
  */
 
 #include <stddef.h>
+#include <stdint.h>
 #include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#if ARENA_PREFAULT_THREAD
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+#if ARENA_TRACE
+#include <chrono>
+#endif
+
+#if _CPP_VERSION >= 201703L
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define _HAS_PMR            1
+#endif
+#endif
+
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+#define _HAS_EXCEPTIONS     1
+#endif
+
+#if _IS_COMPILER_MSVC
+#include <intrin.h>
+#elif _IS_ARCH_X64
+#include <immintrin.h>
+#elif _IS_ARCH_ARM64
+#include <arm_neon.h>
+#endif
 
 #define _glue_step0(x, y)   x##y
 #define _glue(x, y)         _glue_step0(x, y)
 
+#if _IS_COMPILER_MSVC
+#define _NOINLINE       __declspec(noinline)
+#define _unlikely(x)    (x)
+#else
+#define _NOINLINE       __attribute__((noinline, cold))
+#define _unlikely(x)    __builtin_expect(!!(x), 0)
+#endif
+
 // thread safe
 #define _init(tag) \
 static void tag(); \
@@ -50,6 +119,39 @@ constexpr size_t _alignup_pow2(size_t n, size_t align) {
     return (n + (align - 1)) & ~(align - 1);
 }
 
+// x must be non-zero
+inline unsigned int _ctz64(uint64_t x) {
+#if _IS_COMPILER_MSVC
+    unsigned long idx;
+    _BitScanForward64(&idx, x);
+    return static_cast<unsigned int>(idx);
+#else
+    return static_cast<unsigned int>(__builtin_ctzll(x));
+#endif
+}
+
+// index of the highest set bit, x must be non-zero
+inline unsigned int _bsr64(uint64_t x) {
+#if _IS_COMPILER_MSVC
+    unsigned long idx;
+    _BitScanReverse64(&idx, x);
+    return static_cast<unsigned int>(idx);
+#else
+    return 63 - static_cast<unsigned int>(__builtin_clzll(x));
+#endif
+}
+
+// spin-wait hint
+inline void _cpu_relax() {
+#if _IS_COMPILER_MSVC
+    _mm_pause();
+#elif _IS_ARCH_X64
+    __builtin_ia32_pause();
+#elif _IS_ARCH_ARM64
+    __asm__ __volatile__("yield");
+#endif
+}
+
 /*
  *
  */
@@ -74,6 +176,9 @@ _init(_os_win32_sysinfo_init) {
 #elif _IS_OS_LINUX
 
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 _init(_os_linux_pagesize_init) {
@@ -97,6 +202,50 @@ inline void *_os_virtual_reserve(size_t size) {
     return ptr;
 }
 
+#if _IS_OS_LINUX
+// readable and writable up front, the kernel backs pages on first touch.
+// no swap or overcommit accounting is charged for the range
+inline void *_os_virtual_reserve_rw(size_t size) {
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (ptr == MAP_FAILED) {
+        assert(false && "mmap(): reserve failed");
+        return nullptr;
+    }
+    return ptr;
+}
+
+// over-reserves then trims the head and tail
+inline void *_os_virtual_reserve_aligned(size_t size, size_t align) {
+    size_t total = size + align;
+    void *ptr = mmap(NULL, total, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        assert(false && "mmap(): reserve failed");
+        return nullptr;
+    }
+
+    size_t addr = reinterpret_cast<size_t>(ptr);
+    size_t head = _alignup_pow2(addr, align) - addr;
+    size_t tail = total - head - size;
+    if (head != 0) munmap(ptr, head);
+    if (tail != 0) munmap(static_cast<char *>(ptr) + head + size, tail);
+    return static_cast<char *>(ptr) + head;
+}
+#endif
+
+// linux: hugetlbfs pages, reserved up front and committed with mprotect
+// windows: large pages, always committed
+// fails without assert when the system has no huge pages to spare
+inline void *_os_virtual_reserve_large(size_t size) {
+    void *ptr = nullptr;
+#if _IS_OS_WINDOWS
+    ptr = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+#elif _IS_OS_LINUX
+    ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ptr == MAP_FAILED) return nullptr;
+#endif
+    return ptr;
+}
+
 static bool _os_virtual_commit(void *ptr, size_t size) {
 #if _IS_OS_WINDOWS
     void *res = VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE);
@@ -135,6 +284,17 @@ inline bool _os_virtual_decommit(void *ptr, size_t size) {
     return true;
 }
 
+#if _IS_OS_LINUX
+// drops the pages but keeps the range accessible, the next touch faults in zeroes
+inline bool _os_virtual_discard(void *ptr, size_t size) {
+    if (madvise(ptr, size, MADV_DONTNEED) == -1) {
+        assert(false && "madvise(): discard failed");
+        return false;
+    }
+    return true;
+}
+#endif
+
 inline bool _os_virtual_release(void *ptr, size_t size) {
 #if _IS_OS_WINDOWS
     (void)size;
@@ -148,6 +308,280 @@ inline bool _os_virtual_release(void *ptr, size_t size) {
     return true;
 }
 
+#if _IS_OS_LINUX && !defined(MADV_POPULATE_WRITE)
+#define MADV_POPULATE_WRITE 23  // linux 5.14
+#endif
+#if _IS_OS_LINUX && !defined(MFD_CLOEXEC)
+#define MFD_CLOEXEC         1u  // linux 3.17, memfd_create() through syscall()
+#endif
+
+// faults committed pages in without changing their contents, false when the kernel can't
+inline bool _os_virtual_populate(void *ptr, size_t size) {
+#if _IS_OS_LINUX
+    return madvise(ptr, size, MADV_POPULATE_WRITE) == 0 || errno != EINVAL;
+#else
+    (void)ptr; (void)size;
+    return false;
+#endif
+}
+
+// older kernels and windows. writes each page, so only the owner may call it
+// and only on bytes it has not handed out yet
+inline void _os_virtual_touch(void *ptr, size_t size) {
+    for (size_t offset = 0; offset < size; offset += _os_pageSize) {
+        volatile char *byte = static_cast<char *>(ptr) + offset;
+        *byte = *byte;
+    }
+}
+
+/*
+ *
+ */
+
+#if ARENA_PREFAULT_THREAD
+
+// one helper thread populates prefault windows for all arenas, in request order.
+// arenas wait for their last request before unmapping or decommitting.
+// where the kernel can't populate, the window faults on first touch as usual
+
+constexpr unsigned int ARENA_PREFAULT_QUEUE_SIZE = 64;   // requests past it are dropped
+
+struct _Arena_Prefaulter {
+    struct Request {
+        void *ptr;
+        size_t size;
+    };
+
+    std::mutex mutex;
+    std::condition_variable workCond;
+    std::condition_variable doneCond;
+    Request queue[ARENA_PREFAULT_QUEUE_SIZE];
+    uint64_t submitted;
+    std::atomic<uint64_t> completed;
+    bool stop;
+    std::thread thread;
+
+    _Arena_Prefaulter() : submitted(0), completed(0), stop(false) {}
+
+    ~_Arena_Prefaulter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        workCond.notify_one();
+        if (thread.joinable()) thread.join();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            workCond.wait(lock, [this]() { return stop || completed.load(std::memory_order_relaxed) != submitted; });
+            uint64_t done = completed.load(std::memory_order_relaxed);
+            if (done == submitted) return;
+
+            Request request = queue[done % ARENA_PREFAULT_QUEUE_SIZE];
+            lock.unlock();
+            (void)_os_virtual_populate(request.ptr, request.size);
+            lock.lock();
+
+            completed.store(done + 1, std::memory_order_release);
+            doneCond.notify_all();
+        }
+    }
+
+    // returns the ticket to wait for, 0 when dropped
+    uint64_t submit(void *ptr, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (submitted - completed.load(std::memory_order_relaxed) >= ARENA_PREFAULT_QUEUE_SIZE) return 0;
+        if (!thread.joinable()) thread = std::thread([this]() { run(); });
+
+        queue[submitted % ARENA_PREFAULT_QUEUE_SIZE] = { ptr, size };
+        submitted++;
+        workCond.notify_one();
+        return submitted;
+    }
+
+    void wait(uint64_t ticket) {
+        if (completed.load(std::memory_order_acquire) >= ticket) return;
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCond.wait(lock, [&]() { return completed.load(std::memory_order_relaxed) >= ticket; });
+    }
+};
+
+// one per program, started by the first prefault request
+inline _Arena_Prefaulter &_arena_prefaulter() {
+    static _Arena_Prefaulter prefaulter;
+    return prefaulter;
+}
+
+#endif  // ARENA_PREFAULT_THREAD
+
+/*
+ *
+ */
+
+#if ARENA_TRACE
+
+enum Arena_Trace_Kind {
+    ARENA_TRACE_PUSH = 0,
+    ARENA_TRACE_TEMP_BEGIN,
+    ARENA_TRACE_TEMP_END,
+    ARENA_TRACE_SCRATCH_BEGIN,
+    ARENA_TRACE_SCRATCH_END,
+};
+
+#if !defined(ARENA_TRACE_RING_SIZE)
+#define ARENA_TRACE_RING_SIZE   (1u << 16)  // events per thread, power of 2
+#endif
+
+#if _IS_COMPILER_MSVC
+#define _return_address()   _ReturnAddress()
+#else
+#define _return_address()   __builtin_return_address(0)
+#endif
+
+// traced entry points stay out of line, so the return address taken there is the caller's call site.
+// thin typed wrappers are forced inline into the caller for the same reason
+#if _IS_COMPILER_MSVC
+#define _TRACE_ENTRY    __declspec(noinline)
+#define _TRACE_INLINE   __forceinline
+#else
+#define _TRACE_ENTRY    __attribute__((noinline))
+#define _TRACE_INLINE   __attribute__((always_inline)) inline
+#endif
+// the call instruction, not the one after it that may belong to the next line
+#define _trace_site()   (static_cast<const char *>(_return_address()) - 1)
+
+struct Arena_Trace_Event {
+    uint64_t time;          // ns, steady clock
+    const void *arena;
+    const void *site;       // call site of the public function, symbolize with addr2line -i.
+                            // pushes made inside other arena functions point into those
+    size_t size;            // push size
+    size_t pos;             // arena pos after the event
+    Arena_Trace_Kind kind;
+};
+
+// one ring per thread, only its thread writes it.
+// rings are linked into a global list and live until arena_trace_free()
+struct _Arena_Trace_Ring {
+    _Arena_Trace_Ring *next;
+    uint64_t threadId;
+    std::atomic<uint64_t> head;     // events ever written
+    Arena_Trace_Event events[ARENA_TRACE_RING_SIZE];
+};
+
+static std::atomic<_Arena_Trace_Ring *> _arena_traceRings = { nullptr };
+static thread_local _Arena_Trace_Ring *_arena_traceRing = nullptr;
+
+static _Arena_Trace_Ring *_arena_trace_ring_new() {
+    static_assert(_is_pow2(ARENA_TRACE_RING_SIZE), "ARENA_TRACE_RING_SIZE must be power of 2");
+
+    // straight from the os, tracing must not show up in arena stats
+    size_t size = _alignup_pow2(sizeof(_Arena_Trace_Ring), _os_pageSize);
+    void *ptr = _os_virtual_reserve(size);
+    if (ptr == nullptr) return nullptr;
+    if (!_os_virtual_commit(ptr, size)) {
+        _os_virtual_release(ptr, size);
+        return nullptr;
+    }
+
+    auto ring = static_cast<_Arena_Trace_Ring *>(ptr);
+#if _IS_OS_WINDOWS
+    ring->threadId = GetCurrentThreadId();
+#elif _IS_OS_LINUX
+    ring->threadId = static_cast<uint64_t>(syscall(SYS_gettid));
+#endif
+
+    _Arena_Trace_Ring *head = _arena_traceRings.load(std::memory_order_relaxed);
+    do {
+        ring->next = head;
+    } while (!_arena_traceRings.compare_exchange_weak(head, ring, std::memory_order_release));
+
+    _arena_traceRing = ring;
+    return ring;
+}
+
+static void _arena_trace_event(Arena_Trace_Kind kind, const void *arena, size_t size, size_t pos, const void *site) {
+    _Arena_Trace_Ring *ring = _arena_traceRing;
+    if (ring == nullptr) {
+        ring = _arena_trace_ring_new();
+        if (ring == nullptr) return;
+    }
+
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+
+    Arena_Trace_Event *event = &ring->events[head & (ARENA_TRACE_RING_SIZE - 1)];
+    event->time = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+    event->arena = arena;
+    event->site = site;
+    event->size = size;
+    event->pos = pos;
+    event->kind = kind;
+
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+#define _arena_trace(kind, arena, size, pos, site)  _arena_trace_event(kind, arena, size, pos, site)
+
+// chrome trace json (chrome://tracing, perfetto).
+// every arena gets its own async track, temps and scratches are slices on it and pushes instants.
+// scopes only nest within one arena, thread scoped slices would mis-nest when they close
+// out of order across arenas.
+// events written while exporting may show up torn, export from a quiet point
+inline void arena_trace_export(FILE *file) {
+    static const char *names[] = { "push", "temp", "temp", "scratch", "scratch" };
+    static const char *phases[] = { "n", "b", "e", "b", "e" };
+
+#if _IS_OS_WINDOWS
+    unsigned long pid = GetCurrentProcessId();
+#elif _IS_OS_LINUX
+    unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+
+    fprintf(file, "{\"traceEvents\":[");
+    bool first = true;
+    for (auto ring = _arena_traceRings.load(std::memory_order_acquire); ring != nullptr; ring = ring->next) {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t tail = head > ARENA_TRACE_RING_SIZE ? head - ARENA_TRACE_RING_SIZE : 0;
+
+        for (uint64_t i = tail; i < head; i++) {
+            const Arena_Trace_Event *event = &ring->events[i & (ARENA_TRACE_RING_SIZE - 1)];
+            fprintf(file,
+                "%s\n{\"name\":\"%s\",\"cat\":\"arena\",\"ph\":\"%s\",\"id\":\"%p\","
+                "\"ts\":%.3f,\"pid\":%lu,\"tid\":%llu,"
+                "\"args\":{\"arena\":\"%p\",\"site\":\"%p\",\"size\":%zu,\"pos\":%zu}}",
+                first ? "" : ",", names[event->kind], phases[event->kind], event->arena, event->time / 1000.0,
+                pid, static_cast<unsigned long long>(ring->threadId),
+                event->arena, event->site, event->size, event->pos
+            );
+            first = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+}
+
+// no thread may trace during or after this
+inline void arena_trace_free() {
+    _Arena_Trace_Ring *ring = _arena_traceRings.exchange(nullptr, std::memory_order_acquire);
+    while (ring != nullptr) {
+        _Arena_Trace_Ring *next = ring->next;
+        _os_virtual_release(ring, _alignup_pow2(sizeof(_Arena_Trace_Ring), _os_pageSize));
+        ring = next;
+    }
+    _arena_traceRing = nullptr;
+}
+
+#else
+
+#define _TRACE_ENTRY
+#define _TRACE_INLINE   inline
+#define _trace_site()   nullptr
+#define _arena_trace(kind, arena, size, pos, site)  ((void)(site))
+
+#endif  // ARENA_TRACE
+
 /*
  *
  */
@@ -158,6 +592,47 @@ constexpr size_t gigabytes(size_t n) { return megabytes(n) * 1024; }
 
 constexpr size_t ARENA_DEFAULT_RESERVE_SIZE = megabytes(64);
 constexpr size_t ARENA_DEFAULT_PER_COMMIT_SIZE = kilobytes(8);
+constexpr size_t ARENA_HUGE_PAGE_SIZE = megabytes(2);
+constexpr size_t ARENA_CACHE_LINE_SIZE = 64;
+constexpr size_t ARENA_STREAM_CLEAR_SIZE = kilobytes(256);   // clears at least this big bypass the cache
+
+// arena_init flags
+constexpr unsigned int ARENA_FLAG_HUGE_PAGES    = 1u << 0;  // huge page aligned, transparent huge pages
+constexpr unsigned int ARENA_FLAG_HUGE_TLB      = 1u << 1;  // explicit huge pages, falls back to normal
+constexpr unsigned int ARENA_FLAG_CHAINED       = 1u << 2;  // reserve and link a new block when full
+constexpr unsigned int ARENA_FLAG_DEMAND_PAGED  = 1u << 3;  // linux: map read-write up front, commits are accounting only
+
+enum Arena_Page_Mode {
+    ARENA_PAGES_NORMAL = 0,
+    ARENA_PAGES_HUGE,       // transparent huge pages
+    ARENA_PAGES_HUGE_TLB,   // hugetlbfs on linux, large pages on windows
+};
+
+// how much the slow path commits at once, see arena_set_growth()
+enum Arena_Growth {
+    ARENA_GROWTH_FIXED = 0,     // perCommitSize steps
+    ARENA_GROWTH_GEOMETRIC,     // doubling steps up to a cap
+    ARENA_GROWTH_LEARNED,       // geometric, jumps to the previous high-water mark after a reset
+};
+
+#if ARENA_STATS
+// pushes are bucketed by size, bucket n counts [2^n, 2^(n+1)), the last one everything above
+constexpr unsigned int ARENA_STATS_BUCKET_COUNT = 24;
+
+struct Arena_Stats {
+    size_t peakPos;
+    size_t commitCount;
+    size_t commitBytes;
+    size_t decommitCount;
+    size_t decommitBytes;
+    size_t pushCount;
+    size_t pushBuckets[ARENA_STATS_BUCKET_COUNT];
+    size_t paddingBytes;    // lost to alignment
+};
+#endif
+
+struct _Arena_Block;
+struct _Arena_Finalizer;
 
 struct Arena {
     void *ptr;
@@ -165,90 +640,504 @@ struct Arena {
     size_t committed;
     size_t reserved;
     size_t perCommitSize;
+    size_t pageSize;            // commit granularity
+    unsigned int flags;         // requested ARENA_FLAG_*
+    Arena_Page_Mode pageMode;   // obtained page mode
+    bool demandPaged;           // obtained ARENA_FLAG_DEMAND_PAGED, no commit syscalls
+
+    // decommit policy, see arena_set_decommit()
+    size_t decommitThreshold;
+    size_t decommitKeep;
+    size_t decommitted;     // total bytes returned to os
+
+    // bytes from max(pos, zeroPos) to committed are known zero, raised lazily on pop.
+    // see arena_push_zero()
+    size_t zeroPos;
+
+    // growth policy, see arena_set_growth()
+    Arena_Growth growth;
+    size_t commitStep;      // next geometric step
+    size_t maxCommitStep;
+    size_t peakCommitted;   // since the last reset
+    size_t learnedCommit;   // peak of the previous reset cycle
+
+    // prefault, see arena_set_prefault()
+    size_t prefaultWindow;
+#if ARENA_PREFAULT_THREAD
+    uint64_t prefaultTicket;    // last request handed to the helper thread
+#endif
+
+    // file backed, see arena_file_create()/arena_file_open()
+    bool fileBacked;        // a header page precedes ptr
+    int fileFd;             // open while pushes grow the file, -1 otherwise
+    bool fileReadOnly;      // ARENA_FILE_READ_ONLY, nothing is committed and pushes fail
+
+    // chained mode, pos/committed/reserved are relative to the current block
+    size_t basePos;         // arena pos of the current block start
+    _Arena_Block *prev;     // previous block, null for the first block
+
+    // destructors of arena_new() objects, newest first
+    _Arena_Finalizer *finalizers;
+
+#if ARENA_STATS
+    Arena_Stats stats;
+#endif
+};
+
+// previous block of a chained arena,
+// stored in an extra page past the end of the next block's reserved range
+struct _Arena_Block {
+    void *ptr;
+    size_t committed;
+    size_t reserved;
+    size_t pageSize;
+    Arena_Page_Mode pageMode;
+    size_t basePos;
+    _Arena_Block *prev;
 };
 
 static Arena arena_init(
     size_t reserveSize = ARENA_DEFAULT_RESERVE_SIZE,
-    size_t perCommitSize = ARENA_DEFAULT_PER_COMMIT_SIZE
+    size_t perCommitSize = ARENA_DEFAULT_PER_COMMIT_SIZE,
+    unsigned int flags = 0
 ) {
+    void *ptr = nullptr;
+    size_t pageSize = _os_pageSize;
+    size_t committed = 0;
+    Arena_Page_Mode pageMode = ARENA_PAGES_NORMAL;
+    bool demandPaged = false;
+
+    if (flags & ARENA_FLAG_HUGE_TLB) {
 #if _IS_OS_WINDOWS
-    // reserving less than 64KiB on windows is waste,
-    // ptr must be align with dwAllocationGranularity
-    reserveSize = _alignup_pow2(reserveSize, _os_win32_sysInfo.dwAllocationGranularity);
+        size_t largeSize = GetLargePageMinimum();
 #elif _IS_OS_LINUX
-    // linux can reserve 4KiB smallest, basically pagesize
-    reserveSize = _alignup_pow2(reserveSize, _os_pageSize);
+        size_t largeSize = ARENA_HUGE_PAGE_SIZE;
+#endif
+        if (largeSize != 0) {
+            size_t largeReserve = _alignup_pow2(reserveSize, largeSize);
+            ptr = _os_virtual_reserve_large(largeReserve);
+            if (ptr != nullptr) {
+                reserveSize = largeReserve;
+                pageSize = largeSize;
+                pageMode = ARENA_PAGES_HUGE_TLB;
+#if _IS_OS_WINDOWS
+                committed = largeReserve;
+#endif
+            }
+        }
+    }
+
+#if _IS_OS_LINUX
+    if (ptr == nullptr && (flags & ARENA_FLAG_HUGE_PAGES)) {
+        // huge pages need 2MiB aligned ranges, commits are rounded to them too
+        reserveSize = _alignup_pow2(reserveSize, ARENA_HUGE_PAGE_SIZE);
+        ptr = _os_virtual_reserve_aligned(reserveSize, ARENA_HUGE_PAGE_SIZE);
+        if (ptr == nullptr) return {};
+
+        // fails when transparent huge pages are disabled
+        if (madvise(ptr, reserveSize, MADV_HUGEPAGE) == 0) {
+            pageSize = ARENA_HUGE_PAGE_SIZE;
+            pageMode = ARENA_PAGES_HUGE;
+        }
+        if ((flags & ARENA_FLAG_DEMAND_PAGED) && mprotect(ptr, reserveSize, PROT_READ | PROT_WRITE) == 0)
+            demandPaged = true;
+    }
+#endif
+
+    if (ptr == nullptr) {
+#if _IS_OS_WINDOWS
+        // reserving less than 64KiB on windows is waste,
+        // ptr must be align with dwAllocationGranularity
+        reserveSize = _alignup_pow2(reserveSize, _os_win32_sysInfo.dwAllocationGranularity);
+#elif _IS_OS_LINUX
+        // linux can reserve 4KiB smallest, basically pagesize
+        reserveSize = _alignup_pow2(reserveSize, _os_pageSize);
 #endif
+        // ptr is already aligned for us
+#if _IS_OS_LINUX
+        if (flags & ARENA_FLAG_DEMAND_PAGED) {
+            ptr = _os_virtual_reserve_rw(reserveSize);
+            demandPaged = true;
+        } else
+#endif
+        ptr = _os_virtual_reserve(reserveSize);
+        if (ptr == nullptr) return {};
+    }
 
     perCommitSize = perCommitSize < reserveSize ? perCommitSize : reserveSize;
 
     // align per_commit_size with pagesize
-    perCommitSize = _alignup_pow2(perCommitSize, _os_pageSize);
-    // ptr is already aligned for us
-    void *ptr = _os_virtual_reserve(reserveSize);
-    if (ptr == nullptr) return {};
+    perCommitSize = _alignup_pow2(perCommitSize, pageSize);
 
     Arena res = {};
     res.ptr = ptr;
+    res.committed = committed;
     res.reserved = reserveSize;
     res.perCommitSize = perCommitSize;
+    res.pageSize = pageSize;
+    res.flags = flags;
+    res.pageMode = pageMode;
+    res.demandPaged = demandPaged;
+    res.commitStep = perCommitSize;
+    res.maxCommitStep = perCommitSize;
     return res;
 }
 
+inline Arena_Page_Mode arena_get_page_mode(const Arena *arena) {
+    return arena->pageMode;
+}
+
+// false when ARENA_FLAG_DEMAND_PAGED wasn't requested or isn't supported
+inline bool arena_is_demand_paged(const Arena *arena) {
+    return arena->demandPaged;
+}
+
+#if _IS_OS_LINUX
+// a shared file mapping can't be touched past the end of the file
+inline bool _arena_file_grow(const Arena *arena, void *ptr, size_t size) {
+    char *base = static_cast<char *>(arena->ptr) - _os_pageSize;
+    off_t fileSize = static_cast<off_t>(static_cast<char *>(ptr) + size - base);
+
+    struct stat st;
+    if (fstat(arena->fileFd, &st) == -1) return false;
+    if (st.st_size >= fileSize) return true;
+    if (ftruncate(arena->fileFd, fileSize) == -1) {
+        assert(false && "ftruncate(): file grow failed");
+        return false;
+    }
+    return true;
+}
+#endif
+
+// demand paged arenas only move the accounting
+inline bool _arena_commit(const Arena *arena, void *ptr, size_t size) {
+    if (arena->demandPaged) return true;
+#if _IS_OS_LINUX
+    if (arena->fileBacked && arena->fileFd >= 0 && !_arena_file_grow(arena, ptr, size)) return false;
+#endif
+    return _os_virtual_commit(ptr, size);
+}
+
+// bytes to commit for a push needing `needed` more, before clamping to reserved
+inline size_t _arena_commit_size(Arena *arena, size_t needed) {
+    size_t newCommit = _alignup_pow2(needed, arena->perCommitSize);
+    if (arena->growth == ARENA_GROWTH_FIXED) return newCommit;
+
+    size_t step = arena->commitStep;
+    arena->commitStep = step * 2 < arena->maxCommitStep ? step * 2 : arena->maxCommitStep;
+    newCommit = newCommit > step ? newCommit : step;
+
+    if (arena->growth == ARENA_GROWTH_LEARNED && arena->learnedCommit > arena->committed) {
+        size_t learned = arena->learnedCommit - arena->committed;
+        newCommit = newCommit > learned ? newCommit : learned;
+    }
+    return newCommit;
+}
+
+// populates the committed pages past postPos, on the helper thread when there is one
+inline void _arena_prefault(Arena *arena, size_t postPos) {
+    size_t from = _alignup_pow2(postPos, _os_pageSize);
+    if (from >= arena->committed) return;
+
+    void *ptr = static_cast<char *>(arena->ptr) + from;
+    size_t size = arena->committed - from;
+#if ARENA_PREFAULT_THREAD
+    uint64_t ticket = _arena_prefaulter().submit(ptr, size);
+    if (ticket != 0) arena->prefaultTicket = ticket;
+#else
+    if (!_os_virtual_populate(ptr, size)) _os_virtual_touch(ptr, size);
+#endif
+}
+
+inline void _arena_prefault_wait(Arena *arena) {
+#if ARENA_PREFAULT_THREAD
+    if (arena->prefaultTicket == 0) return;
+    _arena_prefaulter().wait(arena->prefaultTicket);
+    arena->prefaultTicket = 0;
+#else
+    (void)arena;
+#endif
+}
+
 inline size_t arena_get_pos(const Arena *arena) {
     // may unaligned !!!
-    return arena->pos;
+    return arena->basePos + arena->pos;
 }
 
-static void *arena_push_ex(Arena *arena, size_t size, size_t align) {
-    // windows and linux always zeroes fresh commits
-    assert(_is_pow2(align) && "alignment must be non-zero power of 2");
+static void *_arena_push_chained(Arena *arena, size_t size, size_t align, const void *site);
 
-    size_t lastPos = _alignup_pow2(arena->pos, align);
-    size_t postPos = lastPos + size;
+// stats, trace and the bump shared by both push paths
+inline void *_arena_push_bump(Arena *arena, size_t size, size_t lastPos, size_t postPos, const void *site) {
+#if ARENA_STATS
+    Arena_Stats *stats = &arena->stats;
+    unsigned int bucket = size > 1 ? _bsr64(size) : 0;
+    bucket = bucket < ARENA_STATS_BUCKET_COUNT ? bucket : ARENA_STATS_BUCKET_COUNT - 1;
+    stats->pushCount++;
+    stats->pushBuckets[bucket]++;
+    stats->paddingBytes += lastPos - arena->pos;
+    if (arena->basePos + postPos > stats->peakPos)
+        stats->peakPos = arena->basePos + postPos;
+#else
+    (void)size;
+#endif
+
+    void *res = static_cast<char *>(arena->ptr) + lastPos;
+    arena->pos = postPos;
+    _arena_trace(ARENA_TRACE_PUSH, arena, size, arena->basePos + postPos, site);
+    return res;
+}
+
+// past committed: chains or commits
+inline void *_arena_push_commit(
+    Arena *arena, size_t size, size_t align, size_t lastPos, size_t postPos, const void *site
+) {
+    if (arena->fileReadOnly) return nullptr;
 
     size_t reserved = arena->reserved;
     if (postPos > reserved) {
+        if (arena->flags & ARENA_FLAG_CHAINED)
+            return _arena_push_chained(arena, size, align, site);
+
         assert(false && "reserved size exceeded");
         return nullptr;
     }
 
+    // commit the prefault window too, it is populated in the background with ARENA_PREFAULT_THREAD
     size_t committed = arena->committed;
-    if (postPos > committed) {
-        size_t needed = postPos - committed;
-        size_t newCommit = _alignup_pow2(needed, arena->perCommitSize);
+    size_t needed = postPos - committed + arena->prefaultWindow;
+    size_t newCommit = _arena_commit_size(arena, needed);
 
-        size_t maxCommit = reserved - committed;
-        newCommit = newCommit < maxCommit ? newCommit : maxCommit;
+    size_t maxCommit = reserved - committed;
+    newCommit = newCommit < maxCommit ? newCommit : maxCommit;
 
-        void *ptr = static_cast<char *>(arena->ptr) + committed;
-        if (!_os_virtual_commit(ptr, newCommit)) return nullptr;
+    void *ptr = static_cast<char *>(arena->ptr) + committed;
+    if (!_arena_commit(arena, ptr, newCommit)) return nullptr;
 
-        arena->committed += newCommit;
-    }
+    arena->committed += newCommit;
+    if (arena->committed > arena->peakCommitted)
+        arena->peakCommitted = arena->committed;
+    if (arena->prefaultWindow != 0)
+        _arena_prefault(arena, postPos);
+#if ARENA_STATS
+    arena->stats.commitCount++;
+    arena->stats.commitBytes += newCommit;
+#endif
 
-    void *res = static_cast<char *>(arena->ptr) + lastPos;
-    arena->pos = postPos;
-    return res;
+    return _arena_push_bump(arena, size, lastPos, postPos, site);
 }
 
-inline void arena_pop_to(Arena *arena, size_t to) { // TODO: decommit version
-    assert(arena->pos >= to && "trying to pop forward");
-    arena->pos = to;
+// out of line so push call sites stay small
+static _NOINLINE void *_arena_push_slow(
+    Arena *arena, size_t size, size_t align, size_t lastPos, size_t postPos, const void *site
+) {
+    return _arena_push_commit(arena, size, align, lastPos, postPos, site);
 }
-inline void arena_pop_by(Arena *arena, size_t by) { // TODO: decommit version
-    arena_pop_to(arena, arena->pos - by);
+
+// committed <= reserved, so the fast path only compares against committed
+inline void *_arena_push(Arena *arena, size_t size, size_t align, const void *site) {
+    // windows and linux always zeroes fresh commits
+    assert(_is_pow2(align) && "alignment must be non-zero power of 2");
+
+    // align the address, reservations are only page aligned
+    size_t base = reinterpret_cast<size_t>(arena->ptr);
+    size_t lastPos = _alignup_pow2(base + arena->pos, align) - base;
+    size_t postPos = lastPos + size;
+
+    if (_unlikely(postPos > arena->committed))
+        return _arena_push_slow(arena, size, align, lastPos, postPos, site);
+    return _arena_push_bump(arena, size, lastPos, postPos, site);
+}
+
+_TRACE_ENTRY inline void *arena_push_ex(Arena *arena, size_t size, size_t align) {
+    return _arena_push(arena, size, align, _trace_site());
+}
+
+// reserves a block big enough for the push and links the current one behind it
+static void *_arena_push_chained(Arena *arena, size_t size, size_t align, const void *site) {
+    size_t needed = size + align;
+    size_t reserveSize = arena->reserved > needed ? arena->reserved : needed;
+
+    // one extra page past reserved holds the previous block
+    Arena next = arena_init(reserveSize + arena->pageSize, arena->perCommitSize, arena->flags);
+    if (next.ptr == nullptr) return nullptr;
+
+    size_t reserved = next.reserved - next.pageSize;
+    auto block = reinterpret_cast<_Arena_Block *>(static_cast<char *>(next.ptr) + reserved);
+    if (next.committed == 0 && !_arena_commit(&next, block, next.pageSize)) {
+        _os_virtual_release(next.ptr, next.reserved);
+        return nullptr;
+    }
+
+    block->ptr = arena->ptr;
+    block->committed = arena->committed;
+    block->reserved = arena->reserved;
+    block->pageSize = arena->pageSize;
+    block->pageMode = arena->pageMode;
+    block->basePos = arena->basePos;
+    block->prev = arena->prev;
+
+    arena->basePos += arena->pos;
+    arena->prev = block;
+    arena->ptr = next.ptr;
+    arena->pos = 0;
+    arena->zeroPos = 0;
+    arena->committed = next.committed < reserved ? next.committed : reserved;
+    arena->reserved = reserved;
+    arena->pageSize = next.pageSize;
+    arena->pageMode = next.pageMode;
+
+    return _arena_push(arena, size, align, site);
+}
+
+// releases the current block and makes the previous one current
+static void _arena_pop_block(Arena *arena) {
+    _arena_prefault_wait(arena);
+    _Arena_Block block = *arena->prev;
+
+    arena->decommitted += arena->committed;
+#if ARENA_STATS
+    arena->stats.decommitCount++;
+    arena->stats.decommitBytes += arena->committed;
+#endif
+    _os_virtual_release(arena->ptr, arena->reserved + arena->pageSize);
+
+    arena->ptr = block.ptr;
+    arena->pos = block.reserved;
+    arena->zeroPos = block.committed;   // not tracked per block
+    arena->committed = block.committed;
+    arena->reserved = block.reserved;
+    arena->pageSize = block.pageSize;
+    arena->pageMode = block.pageMode;
+    arena->basePos = block.basePos;
+    arena->prev = block.prev;
+}
+
+// threshold: decommit on pop when more than this many bytes are committed above pos, 0 disables
+// keep:      bytes kept committed above pos after a decommit (hysteresis), keep < threshold
+inline void arena_set_decommit(Arena *arena, size_t threshold, size_t keep) {
+    assert((threshold == 0 || keep < threshold) && "keep must be less than threshold");
+    arena->decommitThreshold = threshold;
+    arena->decommitKeep = keep;
+}
+
+// fixed:     commit perCommitSize at a time, the default
+// geometric: double the commit step on every commit, from perCommitSize up to maxCommitStep
+// learned:   geometric, and after a pop to 0 the next commit jumps straight to
+//            the committed high-water mark of the previous cycle
+inline void arena_set_growth(Arena *arena, Arena_Growth growth, size_t maxCommitStep = megabytes(64)) {
+    maxCommitStep = _alignup_pow2(maxCommitStep, arena->pageSize);
+    assert(maxCommitStep >= arena->perCommitSize && "max commit step below perCommitSize");
+    arena->growth = growth;
+    arena->commitStep = arena->perCommitSize;
+    arena->maxCommitStep = maxCommitStep;
+}
+
+// keeps window bytes committed ahead of pos and populates them when committing,
+// on a helper thread with ARENA_PREFAULT_THREAD so first touches don't fault on the pushing thread.
+// 0 disables
+inline void arena_set_prefault(Arena *arena, size_t window) {
+    arena->prefaultWindow = _alignup_pow2(window, arena->pageSize);
+}
+
+inline size_t arena_get_decommitted(const Arena *arena) {
+    return arena->decommitted;
+}
+
+// returns committed pages above pos + keep to the os
+static bool arena_decommit(Arena *arena, size_t keep = 0) {
+#if _IS_OS_WINDOWS
+    // large pages can't be decommitted
+    if (arena->pageMode == ARENA_PAGES_HUGE_TLB) return true;
+#endif
+    // file pages are written back, not decommitted
+    if (arena->fileBacked) return true;
+
+    // committed is always page aligned
+    size_t keepPos = _alignup_pow2(arena->pos + keep, arena->pageSize);
+    if (keepPos >= arena->committed) return true;
+    _arena_prefault_wait(arena);
+
+    size_t size = arena->committed - keepPos;
+    void *ptr = static_cast<char *>(arena->ptr) + keepPos;
+#if _IS_OS_LINUX
+    bool ok = arena->demandPaged ? _os_virtual_discard(ptr, size) : _os_virtual_decommit(ptr, size);
+#else
+    bool ok = _os_virtual_decommit(ptr, size);
+#endif
+    if (!ok) return false;
+
+    // recommits come back zeroed
+    arena->committed = keepPos;
+    if (arena->zeroPos > keepPos) arena->zeroPos = keepPos;
+    arena->decommitted += size;
+#if ARENA_STATS
+    arena->stats.decommitCount++;
+    arena->stats.decommitBytes += size;
+#endif
+    return true;
+}
+
+// pushed right before an arena_new() object
+struct _Arena_Finalizer {
+    void (*destroy)(void *ptr, size_t count);
+    void *ptr;
+    size_t count;
+    size_t pos;                 // arena pos before the finalizer
+    _Arena_Finalizer *next;
+};
+
+// runs the destructors of objects at or above pos to, newest first
+inline void _arena_finalize_to(Arena *arena, size_t to) {
+    while (arena->finalizers != nullptr && arena->finalizers->pos >= to) {
+        _Arena_Finalizer *finalizer = arena->finalizers;
+        arena->finalizers = finalizer->next;
+        finalizer->destroy(finalizer->ptr, finalizer->count);
+    }
+}
+
+inline void arena_pop_to(Arena *arena, size_t to) {
+    assert(arena_get_pos(arena) >= to && "trying to pop forward");
+    if (arena->finalizers != nullptr)
+        _arena_finalize_to(arena, to);
+    while (to < arena->basePos)
+        _arena_pop_block(arena);
+    // everything below the old pos may have been written
+    if (arena->pos > arena->zeroPos) arena->zeroPos = arena->pos;
+    arena->pos = to - arena->basePos;
+
+    size_t threshold = arena->decommitThreshold;
+    if (threshold != 0 && arena->committed > arena->pos + threshold)
+        arena_decommit(arena, arena->decommitKeep);
+
+    // a reset ends the cycle the learned policy sizes the next one from
+    if (to == 0 && arena->growth == ARENA_GROWTH_LEARNED) {
+        arena->learnedCommit = arena->peakCommitted;
+        arena->peakCommitted = arena->committed;
+    }
+}
+inline void arena_pop_by(Arena *arena, size_t by) {
+    arena_pop_to(arena, arena_get_pos(arena) - by);
 }
 
 inline void arena_free(Arena *arena) {
+    _arena_finalize_to(arena, 0);
+    while (arena->prev != nullptr)
+        _arena_pop_block(arena);
+    _arena_prefault_wait(arena);
     if (arena->ptr != nullptr) {
+#if _IS_OS_LINUX
+        if (arena->fileBacked) {
+            _os_virtual_release(static_cast<char *>(arena->ptr) - _os_pageSize, arena->reserved + _os_pageSize);
+            if (arena->fileFd >= 0) close(arena->fileFd);
+        } else
+#endif
         _os_virtual_release(arena->ptr, arena->reserved);
     }
     *arena = {};
 }
 
 template <typename T>
-inline T *arena_push(Arena *arena, size_t count = 1) {
+_TRACE_INLINE T *arena_push(Arena *arena, size_t count = 1) {
     void *ptr = arena_push_ex(arena, sizeof(T) * count, alignof(T));
     return static_cast<T *>(ptr);
 }
@@ -257,6 +1146,262 @@ inline void arena_pop(Arena *arena, size_t count = 1) {
     arena_pop_by(arena, sizeof(T) * count);
 }
 
+// memset for small sizes, non-temporal stores for big ones so they don't evict the cache
+inline void _arena_clear(void *ptr, size_t size) {
+    if (size < ARENA_STREAM_CLEAR_SIZE) {
+        memset(ptr, 0, size);
+        return;
+    }
+
+    char *p = static_cast<char *>(ptr);
+    size_t head = _alignup_pow2(reinterpret_cast<size_t>(p), ARENA_CACHE_LINE_SIZE) - reinterpret_cast<size_t>(p);
+    memset(p, 0, head);
+    p += head;
+    size -= head;
+
+    size_t body = size & ~(ARENA_CACHE_LINE_SIZE - 1);
+#if _IS_ARCH_X64
+#if defined(__AVX__)
+    __m256i zero = _mm256_setzero_si256();
+    for (size_t i = 0; i < body; i += 64) {
+        _mm256_stream_si256(reinterpret_cast<__m256i *>(p + i), zero);
+        _mm256_stream_si256(reinterpret_cast<__m256i *>(p + i + 32), zero);
+    }
+#else
+    __m128i zero = _mm_setzero_si128();
+    for (size_t i = 0; i < body; i += 64) {
+        _mm_stream_si128(reinterpret_cast<__m128i *>(p + i), zero);
+        _mm_stream_si128(reinterpret_cast<__m128i *>(p + i + 16), zero);
+        _mm_stream_si128(reinterpret_cast<__m128i *>(p + i + 32), zero);
+        _mm_stream_si128(reinterpret_cast<__m128i *>(p + i + 48), zero);
+    }
+#endif
+    // order the streaming stores before later ordinary stores
+    _mm_sfence();
+#elif _IS_ARCH_ARM64
+    uint8x16_t zero = vdupq_n_u8(0);
+    for (size_t i = 0; i < body; i += 64)
+        __asm__ __volatile__("stnp %q1, %q1, [%0]\n\tstnp %q1, %q1, [%0, #32]" : : "r"(p + i), "w"(zero) : "memory");
+#else
+    memset(p, 0, body);
+#endif
+    memset(p + body, 0, size - body);
+}
+
+// zeroed memory, only the part below the highest pos ever reached is cleared,
+// fresh commits and recommits after a decommit come zeroed from the os
+_TRACE_ENTRY inline void *arena_push_zero_ex(Arena *arena, size_t size, size_t align) {
+    void *block = arena->ptr;
+    size_t dirty = arena->pos > arena->zeroPos ? arena->pos : arena->zeroPos;
+
+    char *ptr = static_cast<char *>(_arena_push(arena, size, align, _trace_site()));
+    if (ptr == nullptr) return nullptr;
+    // chained into a fresh block
+    if (arena->ptr != block) return ptr;
+
+    size_t offset = static_cast<size_t>(ptr - static_cast<char *>(arena->ptr));
+    if (offset < dirty)
+        _arena_clear(ptr, dirty - offset < size ? dirty - offset : size);
+    return ptr;
+}
+template <typename T>
+_TRACE_INLINE T *arena_push_zero(Arena *arena, size_t count = 1) {
+    void *ptr = arena_push_zero_ex(arena, sizeof(T) * count, alignof(T));
+    return static_cast<T *>(ptr);
+}
+
+// arena_push_ex, spelled out where stale contents are fine
+_TRACE_ENTRY inline void *arena_push_nozero_ex(Arena *arena, size_t size, size_t align) {
+    return _arena_push(arena, size, align, _trace_site());
+}
+template <typename T>
+_TRACE_INLINE T *arena_push_nozero(Arena *arena, size_t count = 1) {
+    return arena_push<T>(arena, count);
+}
+
+// grows or shrinks the last push in place, committing as needed.
+// false when ptr isn't the last push or the block has no room left
+inline bool arena_extend(Arena *arena, void *ptr, size_t oldSize, size_t newSize) {
+    char *top = static_cast<char *>(arena->ptr) + arena->pos;
+    if (static_cast<char *>(ptr) + oldSize != top) return false;
+
+    if (newSize <= oldSize) {
+        arena_pop_by(arena, oldSize - newSize);
+        return true;
+    }
+
+    // never chain, the growth must stay contiguous
+    size_t grow = newSize - oldSize;
+    if (grow > arena->reserved - arena->pos) return false;
+    return arena_push_ex(arena, grow, 1) != nullptr;
+}
+
+// in place when ptr is the last push, otherwise pushes and copies, the old block stays behind
+inline void *arena_realloc(Arena *arena, void *ptr, size_t oldSize, size_t newSize, size_t align) {
+    if (ptr != nullptr && arena_extend(arena, ptr, oldSize, newSize)) return ptr;
+
+    void *res = arena_push_ex(arena, newSize, align);
+    if (res != nullptr && ptr != nullptr)
+        memcpy(res, ptr, oldSize < newSize ? oldSize : newSize);
+    return res;
+}
+template <typename T>
+inline T *arena_realloc(Arena *arena, T *ptr, size_t oldCount, size_t newCount) {
+    void *res = arena_realloc(arena, ptr, sizeof(T) * oldCount, sizeof(T) * newCount, alignof(T));
+    return static_cast<T *>(res);
+}
+
+// trivially destructible types get no finalizer, nothing runs on pop
+template <typename T, bool = std::is_trivially_destructible<T>::value>
+struct _Arena_New {
+    static T *push(Arena *arena, size_t count, _Arena_Finalizer **finalizer) {
+        *finalizer = nullptr;
+        return arena_push<T>(arena, count);
+    }
+    static void destroy(void *, size_t) {}
+    static void link(Arena *, _Arena_Finalizer *) {}
+};
+template <typename T>
+struct _Arena_New<T, false> {
+    static void destroy(void *ptr, size_t count) {
+        T *objects = static_cast<T *>(ptr);
+        while (count > 0)
+            objects[--count].~T();
+    }
+
+    // the finalizer goes right before the objects so both are popped together
+    static T *push(Arena *arena, size_t count, _Arena_Finalizer **finalizer) {
+        size_t pos = arena_get_pos(arena);
+        *finalizer = arena_push<_Arena_Finalizer>(arena);
+        T *ptr = *finalizer != nullptr ? arena_push<T>(arena, count) : nullptr;
+        if (ptr == nullptr) {
+            arena_pop_to(arena, pos);
+            return nullptr;
+        }
+        **finalizer = { destroy, ptr, count, pos, nullptr };
+        return ptr;
+    }
+
+    // after construction, so objects its constructor arena_new()s are destroyed after it
+    static void link(Arena *arena, _Arena_Finalizer *finalizer) {
+        finalizer->next = arena->finalizers;
+        arena->finalizers = finalizer;
+    }
+};
+
+// constructs a T in place, its destructor runs when the arena pops past it
+template <typename T, typename... Args>
+inline T *arena_new(Arena *arena, Args &&...args) {
+    size_t pos = arena_get_pos(arena);
+    _Arena_Finalizer *finalizer;
+    T *ptr = _Arena_New<T>::push(arena, 1, &finalizer);
+    if (ptr == nullptr) return nullptr;
+#if _HAS_EXCEPTIONS
+    try {
+        new (ptr) T(std::forward<Args>(args)...);
+    } catch (...) {
+        arena_pop_to(arena, pos);
+        throw;
+    }
+#else
+    (void)pos;
+    new (ptr) T(std::forward<Args>(args)...);
+#endif
+    _Arena_New<T>::link(arena, finalizer);
+    return ptr;
+}
+
+// value initialized, destroyed in reverse order.
+// when a constructor throws, the elements built so far are destroyed and the push is popped
+template <typename T>
+inline T *arena_new_array(Arena *arena, size_t count) {
+    size_t pos = arena_get_pos(arena);
+    _Arena_Finalizer *finalizer;
+    T *ptr = _Arena_New<T>::push(arena, count, &finalizer);
+    if (ptr == nullptr) return nullptr;
+    size_t i = 0;
+#if _HAS_EXCEPTIONS
+    try {
+        for (; i < count; i++)
+            new (ptr + i) T();
+    } catch (...) {
+        _Arena_New<T>::destroy(ptr, i);
+        arena_pop_to(arena, pos);
+        throw;
+    }
+#else
+    (void)pos;
+    for (; i < count; i++)
+        new (ptr + i) T();
+#endif
+    _Arena_New<T>::link(arena, finalizer);
+    return ptr;
+}
+
+// layout entry of a T array aligned to at least Align, e.g. ARENA_CACHE_LINE_SIZE or a simd width
+template <typename T, size_t Align>
+struct Arena_Aligned {};
+
+template <typename T>
+struct _Arena_Layout_Item {
+    using Type = T;
+    static constexpr size_t align = alignof(T);
+};
+template <typename T, size_t Align>
+struct _Arena_Layout_Item<Arena_Aligned<T, Align>> {
+    static_assert(_is_pow2(Align), "alignment must be non-zero power of 2");
+    using Type = T;
+    static constexpr size_t align = Align > alignof(T) ? Align : alignof(T);
+};
+
+// alignments are folded at compile time, only the counts are runtime
+template <typename... Ts>
+struct _Arena_Layout;
+template <>
+struct _Arena_Layout<> {
+    static constexpr size_t align = 1;
+
+    static size_t size(size_t offset) { return offset; }
+    static std::tuple<> get(char *, size_t) { return std::tuple<>(); }
+};
+template <typename T, typename... Ts>
+struct _Arena_Layout<T, Ts...> {
+    using Item = _Arena_Layout_Item<T>;
+    using Type = typename Item::Type;
+    using Next = _Arena_Layout<Ts...>;
+    static constexpr size_t align = Item::align > Next::align ? Item::align : Next::align;
+
+    template <typename... Counts>
+    static size_t size(size_t offset, size_t count, Counts... counts) {
+        offset = _alignup_pow2(offset, Item::align) + sizeof(Type) * count;
+        return Next::size(offset, counts...);
+    }
+
+    template <typename... Counts>
+    static std::tuple<Type *, typename _Arena_Layout_Item<Ts>::Type *...> get(
+        char *base, size_t offset, size_t count, Counts... counts
+    ) {
+        offset = _alignup_pow2(offset, Item::align);
+        return std::tuple_cat(
+            std::make_tuple(reinterpret_cast<Type *>(base + offset)),
+            Next::get(base, offset + sizeof(Type) * count, counts...));
+    }
+};
+
+// parallel arrays in one push, one count per array. null pointers when the push fails
+//   float *xs; int *ids;
+//   std::tie(xs, ids) = arena_push_layout<Arena_Aligned<float, 32>, int>(arena, n, n);
+template <typename... Ts, typename... Counts>
+inline std::tuple<typename _Arena_Layout_Item<Ts>::Type *...> arena_push_layout(Arena *arena, Counts... counts) {
+    static_assert(sizeof...(Ts) == sizeof...(Counts), "one count per array");
+    using Layout = _Arena_Layout<Ts...>;
+
+    size_t size = Layout::size(0, counts...);
+    void *ptr = arena_push_ex(arena, size, Layout::align);
+    if (ptr == nullptr) return std::tuple<typename _Arena_Layout_Item<Ts>::Type *...>();
+    return Layout::get(static_cast<char *>(ptr), 0, counts...);
+}
+
 /*
  *
  */
@@ -266,69 +1411,1805 @@ struct Arena_Temp {
     size_t pos;
 };
 
-inline Arena_Temp arena_temp_begin(Arena *arena) { return { arena, arena_get_pos(arena) }; }
-inline void arena_temp_end(Arena_Temp temp)      { arena_pop_to(temp.arena, temp.pos); }
+_TRACE_ENTRY inline Arena_Temp arena_temp_begin(Arena *arena) {
+    Arena_Temp temp = { arena, arena_get_pos(arena) };
+    _arena_trace(ARENA_TRACE_TEMP_BEGIN, arena, 0, temp.pos, _trace_site());
+    return temp;
+}
+_TRACE_ENTRY inline void arena_temp_end(Arena_Temp temp) {
+    arena_pop_to(temp.arena, temp.pos);
+    _arena_trace(ARENA_TRACE_TEMP_END, temp.arena, 0, temp.pos, _trace_site());
+}
+
+// arena_temp_end() on scope exit, move-only
+struct Temp_Scope {
+    Arena_Temp temp;
+
+    _TRACE_INLINE explicit Temp_Scope(Arena *arena) : temp(arena_temp_begin(arena)) {}
+    Temp_Scope(Temp_Scope &&other) noexcept : temp(other.temp) { other.temp.arena = nullptr; }
+    Temp_Scope &operator=(Temp_Scope &&other) noexcept {
+        if (this != &other) {
+            if (temp.arena != nullptr) arena_temp_end(temp);
+            temp = other.temp;
+            other.temp.arena = nullptr;
+        }
+        return *this;
+    }
+    Temp_Scope(const Temp_Scope &) = delete;
+    Temp_Scope &operator=(const Temp_Scope &) = delete;
+    _TRACE_INLINE ~Temp_Scope() {
+        if (temp.arena != nullptr) arena_temp_end(temp);
+    }
+
+    Arena *arena() const { return temp.arena; }
+};
+
+// a pushed window bumped through with a local pointer, for tight loops of small pushes.
+// no other pushes into the arena until arena_cursor_end(), which pops the unused tail
+struct Arena_Cursor {
+    Arena *arena;
+    char *ptr;
+    char *end;
+};
+
+inline Arena_Cursor arena_cursor_begin(Arena *arena, size_t size) {
+    char *ptr = static_cast<char *>(arena_push_ex(arena, size, 1));
+    if (ptr == nullptr) return {};
+    return { arena, ptr, ptr + size };
+}
+
+// null when the window is used up
+inline void *arena_cursor_push_ex(Arena_Cursor *cursor, size_t size, size_t align) {
+    assert(_is_pow2(align) && "alignment must be non-zero power of 2");
+    size_t addr = _alignup_pow2(reinterpret_cast<size_t>(cursor->ptr), align);
+    if (_unlikely(addr + size > reinterpret_cast<size_t>(cursor->end))) return nullptr;
+    cursor->ptr = reinterpret_cast<char *>(addr + size);
+    return reinterpret_cast<void *>(addr);
+}
+
+template <typename T>
+inline T *arena_cursor_push(Arena_Cursor *cursor, size_t count = 1) {
+    void *ptr = arena_cursor_push_ex(cursor, sizeof(T) * count, alignof(T));
+    return static_cast<T *>(ptr);
+}
+
+inline void arena_cursor_end(Arena_Cursor cursor) {
+    if (cursor.arena == nullptr) return;
+    arena_pop_by(cursor.arena, static_cast<size_t>(cursor.end - cursor.ptr));
+}
 
 /*
  *
  */
 
-struct _Scratch {
-    Arena arena;
-    bool inUse;
+// null terminated, len excludes the terminator
+struct Arena_Str {
+    char *ptr;
+    size_t len;
 };
 
-constexpr unsigned int PER_THREAD_SCRATCH_COUNT = 4;
-static thread_local _Scratch
-    _scratches[PER_THREAD_SCRATCH_COUNT] = {};
+// formats straight into the committed tail above pos,
+// measures and grows only when the tail is too small
+inline Arena_Str arena_str_fmtva(Arena *arena, const char *fmt, va_list args) {
+    va_list copyArgs;
+    va_copy(copyArgs, args);
+
+    char *top = static_cast<char *>(arena->ptr) + arena->pos;
+    // read-only file arenas commit nothing below pos
+    size_t tail = arena->committed > arena->pos ? arena->committed - arena->pos : 0;
 
-inline _Scratch *_scratches_get() {
-    if (_scratches[0].arena.ptr == nullptr) {
-        for (unsigned int i = 0; i < PER_THREAD_SCRATCH_COUNT; i++)
-            _scratches[i].arena = arena_init();
+    int bytes = vsnprintf(top, tail, fmt, args);
+    // the tail is written even when the string doesn't fit, see arena_push_zero()
+    size_t written = bytes < 0 || bytes + 1ull > tail ? tail : bytes + 1ull;
+    if (arena->pos + written > arena->zeroPos) arena->zeroPos = arena->pos + written;
+    if (bytes < 0) {    // bytes == 0: "" is valid string
+        assert(false && "vsnprintf(): failed");
+        va_end(copyArgs);
+        return {};
     }
-    return _scratches;
+
+    // no commit when it fit, ptr == top
+    size_t neededBytes = bytes + 1ull;
+    char *ptr = arena_push<char>(arena, neededBytes);
+    if (ptr != nullptr && neededBytes > tail)
+        vsnprintf(ptr, neededBytes, fmt, copyArgs);
+    va_end(copyArgs);
+
+    if (ptr == nullptr) return {};
+    return { ptr, static_cast<size_t>(bytes) };
 }
 
-inline Arena_Temp scratch_begin() {
-    auto scratches = _scratches_get();
+inline Arena_Str arena_str_fmt(Arena *arena, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    Arena_Str res = arena_str_fmtva(arena, fmt, args);
+    va_end(args);
+    return res;
+}
 
-    for (unsigned int i = 0; i < PER_THREAD_SCRATCH_COUNT; i++) {
-        if (!scratches[i].inUse) {
-            scratches[i].inUse = true;
-            return arena_temp_begin(&scratches[i].arena);
-        }
+// drops the terminator when str is the last push, otherwise copies it to the top
+inline bool _arena_str_to_top(Arena *arena, Arena_Str *str) {
+    // the append would fail anyway, keep pos as is
+    if (arena->fileReadOnly) return false;
+
+    char *top = static_cast<char *>(arena->ptr) + arena->pos;
+    if (str->ptr != nullptr && str->ptr + str->len + 1 == top) {
+        arena_pop_by(arena, 1);
+        return true;
     }
 
-    assert(false && "all scratch arenas in use");
-    return {};
+    char *ptr = arena_push<char>(arena, str->len);
+    if (ptr == nullptr) return false;
+    if (str->len != 0) memcpy(ptr, str->ptr, str->len);
+    str->ptr = ptr;
+    return true;
+}
+
+// chained arenas may move to a new block in between, join the parts there
+inline Arena_Str _arena_str_join(Arena *arena, Arena_Str head, Arena_Str tail) {
+    if (tail.ptr == head.ptr + head.len) return { head.ptr, head.len + tail.len };
+
+    char *ptr = arena_push<char>(arena, head.len + tail.len + 1);
+    if (ptr == nullptr) return {};
+    memcpy(ptr, head.ptr, head.len);
+    memcpy(ptr + head.len, tail.ptr, tail.len + 1);
+    return { ptr, head.len + tail.len };
+}
+
+// in place when str is the last push
+inline Arena_Str arena_str_append(Arena *arena, Arena_Str str, const char *data, size_t len) {
+    if (!_arena_str_to_top(arena, &str)) return {};
+
+    char *ptr = arena_push<char>(arena, len + 1);
+    if (ptr == nullptr) return {};
+    if (len != 0) memcpy(ptr, data, len);
+    ptr[len] = '\0';
+
+    return _arena_str_join(arena, str, { ptr, len });
+}
+
+inline Arena_Str arena_str_append_fmtva(Arena *arena, Arena_Str str, const char *fmt, va_list args) {
+    if (!_arena_str_to_top(arena, &str)) return {};
+
+    Arena_Str tail = arena_str_fmtva(arena, fmt, args);
+    if (tail.ptr == nullptr) return {};
+
+    return _arena_str_join(arena, str, tail);
+}
+
+inline Arena_Str arena_str_append_fmt(Arena *arena, Arena_Str str, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    Arena_Str res = arena_str_append_fmtva(arena, str, fmt, args);
+    va_end(args);
+    return res;
+}
+
+/*
+ *
+ */
+
+#if _IS_OS_LINUX
+
+// arena backed by a file, the first page holds the header and the arena follows it.
+// every open maps it at a new address, store offsets in it, not pointers
+
+constexpr uint64_t ARENA_FILE_MAGIC = 0x31414e4552415a4full;  // "OZARENA1"
+
+struct Arena_File_Header {
+    uint64_t magic;
+    uint64_t pageSize;
+    uint64_t pos;           // as of the last arena_file_save()
+    uint64_t reserved;
+    uint64_t perCommitSize;
+};
+
+enum Arena_File_Mode {
+    ARENA_FILE_READ_ONLY = 0,   // shared read-only mapping, pushes fail
+    ARENA_FILE_COPY_ON_WRITE,   // private mapping, writes and pushes never reach the file
+    ARENA_FILE_READ_WRITE,      // shared mapping, pushes grow the file
+};
+
+inline Arena_File_Header *_arena_file_header(const Arena *arena) {
+    return reinterpret_cast<Arena_File_Header *>(static_cast<char *>(arena->ptr) - _os_pageSize);
 }
 
-inline bool scratch_end(Arena_Temp scratch) {
-    for (size_t i = 0; i < PER_THREAD_SCRATCH_COUNT; i++) {
-        if (scratch.arena == &_scratches[i].arena) {
-            _scratches[i].inUse = false;
-            arena_temp_end(scratch);
-            return true;
+// fileSize bytes of the file are accessible, the rest of the reserve is committed by pushes
+inline Arena _arena_file_map(int fd, size_t reserveSize, size_t perCommitSize, size_t fileSize, Arena_File_Mode mode) {
+    size_t mapSize = _os_pageSize + reserveSize;
+    void *base = MAP_FAILED;
+
+    if (mode == ARENA_FILE_READ_ONLY) {
+        reserveSize = fileSize - _os_pageSize;
+        base = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    } else if (mode == ARENA_FILE_COPY_ON_WRITE) {
+        // anonymous reservation with the file mapped privately over its head
+        void *reserve = _os_virtual_reserve(mapSize);
+        if (reserve == nullptr) return {};
+        base = mmap(reserve, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+        if (base == MAP_FAILED) _os_virtual_release(reserve, mapSize);
+    } else {
+        base = mmap(NULL, mapSize, PROT_NONE, MAP_SHARED, fd, 0);
+        if (base != MAP_FAILED && mprotect(base, fileSize, PROT_READ | PROT_WRITE) == -1) {
+            munmap(base, mapSize);
+            base = MAP_FAILED;
         }
     }
+    if (base == MAP_FAILED) return {};
 
-    assert(false && "non-scratch argument passed");
-    return false;
+    perCommitSize = perCommitSize < reserveSize ? perCommitSize : reserveSize;
+    perCommitSize = _alignup_pow2(perCommitSize, _os_pageSize);
+
+    Arena res = {};
+    res.ptr = static_cast<char *>(base) + _os_pageSize;
+    // the mapping is PROT_READ, so no byte of it counts as committed
+    res.committed = mode == ARENA_FILE_READ_ONLY ? 0 : fileSize - _os_pageSize;
+    res.zeroPos = res.committed;    // file contents past pos are stale
+    res.reserved = reserveSize;
+    res.perCommitSize = perCommitSize;
+    res.pageSize = _os_pageSize;
+    res.commitStep = perCommitSize;
+    res.maxCommitStep = perCommitSize;
+    res.fileBacked = true;
+    res.fileFd = mode == ARENA_FILE_READ_WRITE ? fd : -1;
+    res.fileReadOnly = mode == ARENA_FILE_READ_ONLY;
+    return res;
 }
 
-inline void scratches_free() {
-    if (_scratches[0].arena.ptr != nullptr) {
-        for (size_t i = 0; i < PER_THREAD_SCRATCH_COUNT; i++) {
-            arena_free(&_scratches[i].arena);
-            _scratches[i].inUse = false;
-        }
+// creates or truncates path, pushes grow the file
+inline Arena arena_file_create(
+    const char *path,
+    size_t reserveSize = ARENA_DEFAULT_RESERVE_SIZE,
+    size_t perCommitSize = ARENA_DEFAULT_PER_COMMIT_SIZE
+) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) return {};
+
+    reserveSize = _alignup_pow2(reserveSize, _os_pageSize);
+    Arena res = {};
+    if (ftruncate(fd, _os_pageSize) == 0)
+        res = _arena_file_map(fd, reserveSize, perCommitSize, _os_pageSize, ARENA_FILE_READ_WRITE);
+    if (res.ptr == nullptr) {
+        close(fd);
+        return {};
+    }
+
+    *_arena_file_header(&res) = { ARENA_FILE_MAGIC, _os_pageSize, 0, res.reserved, res.perCommitSize };
+    return res;
+}
+
+// maps a saved arena as is, one mmap whatever its size.
+// fails without assert on missing or foreign files
+inline Arena arena_file_open(const char *path, Arena_File_Mode mode) {
+    int fd = open(path, mode == ARENA_FILE_READ_WRITE ? O_RDWR : O_RDONLY);
+    if (fd == -1) return {};
+
+    Arena_File_Header header;
+    struct stat st;
+    bool valid =
+        pread(fd, &header, sizeof(header), 0) == sizeof(header) && fstat(fd, &st) == 0 &&
+        header.magic == ARENA_FILE_MAGIC && header.pageSize == _os_pageSize &&
+        size_t(st.st_size) % _os_pageSize == 0 && size_t(st.st_size) >= _os_pageSize + header.pos &&
+        size_t(st.st_size) <= _os_pageSize + header.reserved;
+
+    Arena res = {};
+    if (valid) res = _arena_file_map(fd, header.reserved, header.perCommitSize, st.st_size, mode);
+    if (res.ptr == nullptr || mode != ARENA_FILE_READ_WRITE) close(fd);
+
+    res.pos = res.ptr != nullptr ? header.pos : 0;
+    return res;
+}
+
+// persists pos and flushes the file, read-write file arenas only
+inline bool arena_file_save(Arena *arena) {
+    if (!arena->fileBacked || arena->fileFd < 0) return false;
+
+    Arena_File_Header *header = _arena_file_header(arena);
+    header->pos = arena->pos;
+    size_t size = _alignup_pow2(_os_pageSize + arena->pos, _os_pageSize);
+    if (msync(header, size, MS_SYNC) == -1) {
+        assert(false && "msync(): save failed");
+        return false;
     }
+    return true;
 }
 
+#endif  // _IS_OS_LINUX
+
 /*
  *
  */
 
-// TODO: bitmap allocator
-// https://medium.com/@tom_84912/object-allocators-%E1%B4%99-us-dc0edda80c58
+// arena that many threads can push into at once.
+// pos is bumped with a compare-and-swap, one thread at a time commits.
+// pop and free are not thread safe
+
+constexpr size_t ARENA_SHARED_GRAIN = 16;   // pos is always a multiple of it
+
+// the hot counter gets a cache line to itself
+struct Arena_Shared {
+    alignas(64) std::atomic<size_t> pos;
+
+    alignas(64) void *ptr;
+    std::atomic<size_t> committed;
+    std::atomic<bool> committing;
+    size_t reserved;
+    size_t perCommitSize;
+};
+static_assert(alignof(Arena_Shared) == 64, "pos must start a cache line");
+
+inline bool arena_shared_init(
+    Arena_Shared *arena,
+    size_t reserveSize = ARENA_DEFAULT_RESERVE_SIZE,
+    size_t perCommitSize = ARENA_DEFAULT_PER_COMMIT_SIZE,
+    unsigned int flags = 0
+) {
+    assert(!(flags & ARENA_FLAG_CHAINED) && "shared arenas can't be chained");
+
+    Arena base = arena_init(reserveSize, perCommitSize, flags);
+    if (base.ptr == nullptr) return false;
+
+    arena->pos.store(0, std::memory_order_relaxed);
+    arena->ptr = base.ptr;
+    // demand paged arenas never take the commit lock
+    size_t committed = base.demandPaged ? base.reserved : base.committed;
+    arena->committed.store(committed, std::memory_order_relaxed);
+    arena->committing.store(false, std::memory_order_relaxed);
+    arena->reserved = base.reserved;
+    arena->perCommitSize = base.perCommitSize;
+    return true;
+}
+
+inline size_t arena_shared_get_pos(const Arena_Shared *arena) {
+    return arena->pos.load(std::memory_order_relaxed);
+}
+
+static bool _arena_shared_commit(Arena_Shared *arena, size_t postPos) {
+    size_t reserved = arena->reserved;
+    if (postPos > reserved) {
+        assert(false && "reserved size exceeded");
+        return false;
+    }
+
+    for (;;) {
+        size_t committed = arena->committed.load(std::memory_order_acquire);
+        if (postPos <= committed) return true;
+
+        // one thread commits, the rest wait until their range is covered
+        if (arena->committing.exchange(true, std::memory_order_acquire)) {
+            _cpu_relax();
+            continue;
+        }
+
+        bool ok = true;
+        committed = arena->committed.load(std::memory_order_relaxed);
+        if (postPos > committed) {
+            size_t needed = postPos - committed;
+            size_t newCommit = _alignup_pow2(needed, arena->perCommitSize);
+
+            size_t maxCommit = reserved - committed;
+            newCommit = newCommit < maxCommit ? newCommit : maxCommit;
+
+            void *ptr = static_cast<char *>(arena->ptr) + committed;
+            ok = _os_virtual_commit(ptr, newCommit);
+            if (ok) arena->committed.store(committed + newCommit, std::memory_order_release);
+        }
+
+        arena->committing.store(false, std::memory_order_release);
+        return ok;
+    }
+}
+
+// null once the reservation can't fit the push. which push that is depends on timing,
+// so it doesn't assert. pos never passes the reservation, smaller pushes may still fit
+inline void *arena_shared_push_ex(Arena_Shared *arena, size_t size, size_t align) {
+    assert(_is_pow2(align) && "alignment must be non-zero power of 2");
+
+    // pos stays a multiple of the grain, both sizes and alignments round up to it
+    size = _alignup_pow2(size, ARENA_SHARED_GRAIN);
+    size_t base = reinterpret_cast<size_t>(arena->ptr);
+    size_t pos = arena->pos.load(std::memory_order_relaxed);
+    size_t lastPos, postPos;
+    do {
+        lastPos = _alignup_pow2(base + pos, align) - base;
+        postPos = lastPos + size;
+        if (postPos > arena->reserved || postPos < lastPos) return nullptr;
+    } while (!arena->pos.compare_exchange_weak(pos, postPos, std::memory_order_relaxed));
+
+    if (postPos > arena->committed.load(std::memory_order_acquire)) {
+        if (!_arena_shared_commit(arena, postPos)) return nullptr;
+    }
+
+    return static_cast<char *>(arena->ptr) + lastPos;
+}
+
+// no pushes may be in flight
+inline void arena_shared_pop_to(Arena_Shared *arena, size_t to) {
+    assert(arena_shared_get_pos(arena) >= to && "trying to pop forward");
+    arena->pos.store(_alignup_pow2(to, ARENA_SHARED_GRAIN), std::memory_order_relaxed);
+}
+
+inline void arena_shared_free(Arena_Shared *arena) {
+    if (arena->ptr != nullptr)
+        _os_virtual_release(arena->ptr, arena->reserved);
+    arena->ptr = nullptr;
+    arena->pos.store(0, std::memory_order_relaxed);
+    arena->committed.store(0, std::memory_order_relaxed);
+    arena->reserved = 0;
+}
+
+template <typename T>
+inline T *arena_shared_push(Arena_Shared *arena, size_t count = 1) {
+    void *ptr = arena_shared_push_ex(arena, sizeof(T) * count, alignof(T));
+    return static_cast<T *>(ptr);
+}
+
+/*
+ *
+ */
+
+#if _IS_OS_LINUX
+
+// arena in a memfd or named shm object that several processes map at once.
+// pushes bump pos in the shared header, commits grow the object with fallocate.
+// every process maps it at its own address, exchange offsets or Rel_Ptr, not pointers.
+// producers publish the end of finished data, consumers read up to it
+
+constexpr uint64_t ARENA_SHM_MAGIC = 0x314d48535a4full;   // "OZSHM1"
+
+struct Arena_Shm_Info {
+    uint64_t magic;
+    size_t reserved;
+    size_t perCommitSize;
+};
+
+// first page of the object
+struct Arena_Shm_Header {
+    Arena_Shm_Info info;
+    char _pad0[64 - sizeof(Arena_Shm_Info)];
+    std::atomic<size_t> pos;
+    char _pad1[64 - sizeof(std::atomic<size_t>)];   // keep the hot counter on its own cache line
+    std::atomic<size_t> committed;
+    std::atomic<size_t> published;
+};
+
+struct Arena_Shm {
+    Arena_Shm_Header *header;
+    char *ptr;          // data, the page after the header
+    size_t reserved;
+    size_t perCommitSize;
+    int fd;
+    bool readOnly;
+};
+
+inline bool _arena_shm_map(Arena_Shm *arena, int fd, size_t reserved, bool readOnly) {
+    // pages past the end of the object fault until a commit covers them
+    int prot = readOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+    void *base = mmap(NULL, _os_pageSize + reserved, prot, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) return false;
+
+    arena->header = static_cast<Arena_Shm_Header *>(base);
+    arena->ptr = static_cast<char *>(base) + _os_pageSize;
+    arena->reserved = reserved;
+    arena->fd = fd;
+    arena->readOnly = readOnly;
+    return true;
+}
+
+// name null: an anonymous memfd, hand arena->fd to other processes over a unix socket or fork.
+// otherwise a named shm object, see arena_shm_open() and arena_shm_unlink()
+inline bool arena_shm_create(
+    Arena_Shm *arena,
+    const char *name = nullptr,
+    size_t reserveSize = ARENA_DEFAULT_RESERVE_SIZE,
+    size_t perCommitSize = ARENA_DEFAULT_PER_COMMIT_SIZE
+) {
+    int fd = name == nullptr
+        ? static_cast<int>(syscall(SYS_memfd_create, "arena", MFD_CLOEXEC))
+        : shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1) return false;
+
+    reserveSize = _alignup_pow2(reserveSize, _os_pageSize);
+    perCommitSize = perCommitSize < reserveSize ? perCommitSize : reserveSize;
+    perCommitSize = _alignup_pow2(perCommitSize, _os_pageSize);
+
+    if (posix_fallocate(fd, 0, _os_pageSize) != 0 || !_arena_shm_map(arena, fd, reserveSize, false)) {
+        close(fd);
+        if (name != nullptr) shm_unlink(name);
+        return false;
+    }
+
+    Arena_Shm_Header *header = new (arena->header) Arena_Shm_Header();
+    header->info = { ARENA_SHM_MAGIC, reserveSize, perCommitSize };
+    arena->perCommitSize = perCommitSize;
+    return true;
+}
+
+// takes ownership of fd, read-only arenas can't push.
+// fails without assert on foreign objects
+inline bool arena_shm_open_fd(Arena_Shm *arena, int fd, bool readOnly) {
+    Arena_Shm_Info info;
+    if (pread(fd, &info, sizeof(info), 0) != sizeof(info) || info.magic != ARENA_SHM_MAGIC ||
+        !_arena_shm_map(arena, fd, info.reserved, readOnly)) {
+        close(fd);
+        return false;
+    }
+
+    arena->perCommitSize = info.perCommitSize;
+    return true;
+}
+
+inline bool arena_shm_open(Arena_Shm *arena, const char *name, bool readOnly) {
+    int fd = shm_open(name, readOnly ? O_RDONLY : O_RDWR, 0);
+    if (fd == -1) return false;
+    return arena_shm_open_fd(arena, fd, readOnly);
+}
+
+// the object lives on while other processes map it
+inline void arena_shm_close(Arena_Shm *arena) {
+    if (arena->header != nullptr) {
+        munmap(arena->header, _os_pageSize + arena->reserved);
+        close(arena->fd);
+    }
+    *arena = {};
+}
+
+// removes the name, mappings stay valid
+inline bool arena_shm_unlink(const char *name) {
+    return shm_unlink(name) == 0;
+}
+
+inline size_t arena_shm_get_pos(const Arena_Shm *arena) {
+    return arena->header->pos.load(std::memory_order_relaxed);
+}
+
+static bool _arena_shm_commit(Arena_Shm *arena, size_t postPos) {
+    std::atomic<size_t> *committed = &arena->header->committed;
+    size_t current = committed->load(std::memory_order_acquire);
+    if (postPos <= current) return true;
+
+    size_t target = _alignup_pow2(postPos, arena->perCommitSize);
+    target = target < arena->reserved ? target : arena->reserved;
+
+    // fallocate never shrinks, racing processes may all grow it
+    if (posix_fallocate(arena->fd, 0, _os_pageSize + target) != 0) {
+        assert(false && "posix_fallocate(): commit failed");
+        return false;
+    }
+    while (current < target &&
+        !committed->compare_exchange_weak(current, target, std::memory_order_release, std::memory_order_acquire)) {}
+    return true;
+}
+
+inline void *arena_shm_push_ex(Arena_Shm *arena, size_t size, size_t align) {
+    assert(!arena->readOnly && "read-only shm arena");
+    assert(_is_pow2(align) && align <= _os_pageSize && "alignment must be a power of 2 up to the page size");
+
+    // data starts page aligned, aligning offsets aligns addresses in every process.
+    // like arena_shared_push_ex(), pos never passes the reservation
+    size = _alignup_pow2(size, ARENA_SHARED_GRAIN);
+    size_t pos = arena->header->pos.load(std::memory_order_relaxed);
+    size_t lastPos, postPos;
+    do {
+        lastPos = _alignup_pow2(pos, align);
+        postPos = lastPos + size;
+        if (postPos > arena->reserved || postPos < lastPos) return nullptr;
+    } while (!arena->header->pos.compare_exchange_weak(pos, postPos, std::memory_order_relaxed));
+    if (postPos > arena->header->committed.load(std::memory_order_acquire)) {
+        if (!_arena_shm_commit(arena, postPos)) return nullptr;
+    }
+
+    return arena->ptr + lastPos;
+}
+
+template <typename T>
+inline T *arena_shm_push(Arena_Shm *arena, size_t count = 1) {
+    void *ptr = arena_shm_push_ex(arena, sizeof(T) * count, alignof(T));
+    return static_cast<T *>(ptr);
+}
+
+// everything written before publishing is visible to consumers that read up to pos
+inline void arena_shm_publish(Arena_Shm *arena, size_t pos) {
+    std::atomic<size_t> *published = &arena->header->published;
+    size_t current = published->load(std::memory_order_relaxed);
+    while (current < pos &&
+        !published->compare_exchange_weak(current, pos, std::memory_order_release, std::memory_order_relaxed)) {}
+}
+
+inline size_t arena_shm_get_published(const Arena_Shm *arena) {
+    return arena->header->published.load(std::memory_order_acquire);
+}
+
+inline size_t arena_shm_offset_of(const Arena_Shm *arena, const void *ptr) {
+    return static_cast<size_t>(static_cast<const char *>(ptr) - arena->ptr);
+}
+
+template <typename T = void>
+inline T *arena_shm_ptr_at(const Arena_Shm *arena, size_t offset) {
+    return reinterpret_cast<T *>(arena->ptr + offset);
+}
+
+#endif  // _IS_OS_LINUX
+
+/*
+ *
+ */
+
+// ring of size bytes mapped twice back to back, a push that wraps the end stays contiguous.
+// frees in push order by releasing up to a position, not thread safe.
+// positions only grow, the offset in the ring is pos & (size - 1)
+
+struct Arena_Ring {
+    char *ptr;
+    size_t size;        // power of 2, multiple of the allocation granularity
+    size_t head;        // next push
+    size_t tail;        // oldest unreleased byte
+};
+
+// the mapping is aligned to this, and ring sizes are multiples of it
+inline size_t _arena_ring_granularity() {
+#if _IS_OS_WINDOWS
+    return _os_win32_sysInfo.dwAllocationGranularity;
+#elif _IS_OS_LINUX
+    return _os_pageSize;
+#endif
+}
+
+// size is rounded up to a power of 2
+inline bool arena_ring_init(Arena_Ring *ring, size_t size) {
+    size_t granularity = _arena_ring_granularity();
+    size = size > granularity ? size : granularity;
+    size = size_t(1) << (_bsr64(size - 1) + 1);
+
+    void *base = nullptr;
+#if _IS_OS_WINDOWS
+    HANDLE mapping = CreateFileMappingA(
+        INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+        static_cast<DWORD>(uint64_t(size) >> 32), static_cast<DWORD>(size), NULL
+    );
+    if (mapping == NULL) return false;
+
+    // another thread may take the range between the probe and the views, retry
+    for (int attempt = 0; attempt < 16 && base == nullptr; attempt++) {
+        void *probe = VirtualAlloc(NULL, size * 2, MEM_RESERVE, PAGE_NOACCESS);
+        if (probe == NULL) break;
+        VirtualFree(probe, 0, MEM_RELEASE);
+
+        void *first = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size, probe);
+        if (first == NULL) continue;
+        void *second = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size, static_cast<char *>(probe) + size);
+        if (second != NULL) base = first;
+        else UnmapViewOfFile(first);
+    }
+    // the views keep the section alive
+    CloseHandle(mapping);
+#elif _IS_OS_LINUX
+    int fd = static_cast<int>(syscall(SYS_memfd_create, "arena_ring", MFD_CLOEXEC));
+    if (fd == -1) return false;
+
+    void *reserve = ftruncate(fd, size) == 0 ? _os_virtual_reserve(size * 2) : nullptr;
+    if (reserve != nullptr) {
+        void *first = mmap(reserve, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+        void *second = mmap(static_cast<char *>(reserve) + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+        if (first != MAP_FAILED && second != MAP_FAILED) base = reserve;
+        else munmap(reserve, size * 2);
+    }
+    // the mappings keep the memfd alive
+    close(fd);
+#endif
+    if (base == nullptr) return false;
+
+    ring->ptr = static_cast<char *>(base);
+    ring->size = size;
+    ring->head = 0;
+    ring->tail = 0;
+    return true;
+}
+
+inline void arena_ring_free(Arena_Ring *ring) {
+    if (ring->ptr != nullptr) {
+#if _IS_OS_WINDOWS
+        UnmapViewOfFile(ring->ptr + ring->size);
+        UnmapViewOfFile(ring->ptr);
+#elif _IS_OS_LINUX
+        munmap(ring->ptr, ring->size * 2);
+#endif
+    }
+    *ring = {};
+}
+
+// null when full, that is backpressure, not an error
+inline void *arena_ring_push_ex(Arena_Ring *ring, size_t size, size_t align) {
+    assert(_is_pow2(align) && align <= _arena_ring_granularity() && "alignment must be a power of 2 up to the granularity");
+
+    // the mapping is only granularity aligned and the size is a multiple of it,
+    // so aligning positions aligns addresses up to the granularity
+    size_t lastPos = _alignup_pow2(ring->head, align);
+    size_t postPos = lastPos + size;
+    if (postPos - ring->tail > ring->size) return nullptr;
+
+    ring->head = postPos;
+    return ring->ptr + (lastPos & (ring->size - 1));
+}
+
+template <typename T>
+inline T *arena_ring_push(Arena_Ring *ring, size_t count = 1) {
+    void *ptr = arena_ring_push_ex(ring, sizeof(T) * count, alignof(T));
+    return static_cast<T *>(ptr);
+}
+
+inline size_t arena_ring_get_pos(const Arena_Ring *ring) {
+    return ring->head;
+}
+
+inline size_t arena_ring_get_used(const Arena_Ring *ring) {
+    return ring->head - ring->tail;
+}
+
+// frees everything pushed before pos, O(1)
+inline void arena_ring_release_to(Arena_Ring *ring, size_t pos) {
+    assert(pos >= ring->tail && pos <= ring->head && "release position outside the ring");
+    ring->tail = pos;
+}
+
+// frees everything up to the end of a push
+inline void arena_ring_release(Arena_Ring *ring, const void *ptr, size_t size) {
+    // the end is in (tail, head], measured back from head so a full ring releases too
+    size_t mask = ring->size - 1;
+    size_t end = static_cast<size_t>(static_cast<const char *>(ptr) - ring->ptr) + size;
+    arena_ring_release_to(ring, ring->head - ((ring->head - end) & mask));
+}
+
+/*
+ *
+ */
+
+// two stacks in one reservation, the low side grows up from the start, the high side down from the end.
+// positions and commits are counted from each side's own end.
+// the sides meet at a page boundary, so each owns whole pages and commits and decommits them alone
+
+enum Arena_Side {
+    ARENA_SIDE_LOW = 0,
+    ARENA_SIDE_HIGH = 1,
+};
+
+struct Arena_Dual {
+    char *ptr;
+    size_t reserved;
+    size_t perCommitSize;
+    size_t pos[2];          // per side
+    size_t committed[2];    // per side, page aligned, the ranges never overlap
+
+    // decommit policy for both sides, see arena_dual_set_decommit()
+    size_t decommitThreshold;
+    size_t decommitKeep;
+};
+
+struct Arena_Dual_Temp {
+    Arena_Dual *arena;
+    Arena_Side side;
+    size_t pos;
+};
+
+inline Arena_Dual arena_dual_init(
+    size_t reserveSize = ARENA_DEFAULT_RESERVE_SIZE,
+    size_t perCommitSize = ARENA_DEFAULT_PER_COMMIT_SIZE
+) {
+#if _IS_OS_WINDOWS
+    reserveSize = _alignup_pow2(reserveSize, _os_win32_sysInfo.dwAllocationGranularity);
+#elif _IS_OS_LINUX
+    reserveSize = _alignup_pow2(reserveSize, _os_pageSize);
+#endif
+    void *ptr = _os_virtual_reserve(reserveSize);
+    if (ptr == nullptr) return {};
+
+    perCommitSize = perCommitSize < reserveSize ? perCommitSize : reserveSize;
+    perCommitSize = _alignup_pow2(perCommitSize, _os_pageSize);
+
+    Arena_Dual res = {};
+    res.ptr = static_cast<char *>(ptr);
+    res.reserved = reserveSize;
+    res.perCommitSize = perCommitSize;
+    return res;
+}
+
+inline void arena_dual_free(Arena_Dual *arena) {
+    if (arena->ptr != nullptr)
+        _os_virtual_release(arena->ptr, arena->reserved);
+    *arena = {};
+}
+
+inline size_t arena_dual_get_pos(const Arena_Dual *arena, Arena_Side side) {
+    return arena->pos[side];
+}
+
+// address of [from, to) counted from the side's end
+inline char *_arena_dual_range(const Arena_Dual *arena, Arena_Side side, size_t from, size_t to) {
+    return side == ARENA_SIDE_LOW ? arena->ptr + from : arena->ptr + arena->reserved - to;
+}
+
+// grows the side's committed range to cover postPos, committing only the gap between the sides.
+// pages the other side committed but doesn't use change hands without syscalls
+static bool _arena_dual_commit(Arena_Dual *arena, Arena_Side side, size_t postPos) {
+    Arena_Side other = static_cast<Arena_Side>(side ^ 1);
+    size_t limit = arena->reserved - _alignup_pow2(arena->pos[other], _os_pageSize);
+    size_t target = _alignup_pow2(postPos, arena->perCommitSize);
+    target = target < limit ? target : limit;
+
+    size_t gapEnd = arena->reserved - arena->committed[other];
+    size_t commitEnd = target < gapEnd ? target : gapEnd;
+    size_t committed = arena->committed[side];
+    if (commitEnd > committed) {
+        char *ptr = _arena_dual_range(arena, side, committed, commitEnd);
+        if (!_os_virtual_commit(ptr, commitEnd - committed)) return false;
+    }
+
+    if (target > gapEnd) arena->committed[other] = arena->reserved - target;
+    arena->committed[side] = target;
+    return true;
+}
+
+inline void *arena_dual_push_ex(Arena_Dual *arena, Arena_Side side, size_t size, size_t align) {
+    assert(_is_pow2(align) && "alignment must be non-zero power of 2");
+
+    size_t base = reinterpret_cast<size_t>(arena->ptr);
+    size_t pos = arena->pos[side];
+    size_t lastPos, postPos;
+    if (side == ARENA_SIDE_LOW) {
+        lastPos = _alignup_pow2(base + pos, align) - base;
+        postPos = lastPos + size;
+    } else {
+        // the high side aligns its new low end down
+        size_t top = base + arena->reserved - pos;
+        if (size > top - base) postPos = SIZE_MAX;
+        else postPos = base + arena->reserved - ((top - size) & ~(align - 1));
+        lastPos = postPos - size;
+    }
+
+    Arena_Side other = static_cast<Arena_Side>(side ^ 1);
+    size_t otherPos = _alignup_pow2(arena->pos[other], _os_pageSize);
+    if (postPos > arena->reserved - otherPos || _alignup_pow2(postPos, _os_pageSize) > arena->reserved - otherPos) {
+        assert(false && "dual arena sides met");
+        return nullptr;
+    }
+
+    if (postPos > arena->committed[side]) {
+        if (!_arena_dual_commit(arena, side, postPos)) return nullptr;
+    }
+
+    arena->pos[side] = postPos;
+    return _arena_dual_range(arena, side, lastPos, postPos);
+}
+
+template <typename T>
+inline T *arena_dual_push(Arena_Dual *arena, Arena_Side side, size_t count = 1) {
+    void *ptr = arena_dual_push_ex(arena, side, sizeof(T) * count, alignof(T));
+    return static_cast<T *>(ptr);
+}
+
+// threshold: decommit on pop when more than this many bytes are committed past a side's pos, 0 disables
+// keep:      bytes kept committed past pos after a decommit, keep < threshold
+inline void arena_dual_set_decommit(Arena_Dual *arena, size_t threshold, size_t keep) {
+    assert((threshold == 0 || keep < threshold) && "keep must be less than threshold");
+    arena->decommitThreshold = threshold;
+    arena->decommitKeep = keep;
+}
+
+// returns the side's committed pages past pos + keep to the os
+inline bool arena_dual_decommit(Arena_Dual *arena, Arena_Side side, size_t keep = 0) {
+    size_t keepPos = _alignup_pow2(arena->pos[side] + keep, _os_pageSize);
+    size_t committed = arena->committed[side];
+    if (keepPos >= committed) return true;
+
+    char *ptr = _arena_dual_range(arena, side, keepPos, committed);
+    if (!_os_virtual_decommit(ptr, committed - keepPos)) return false;
+    arena->committed[side] = keepPos;
+    return true;
+}
+
+inline void arena_dual_pop_to(Arena_Dual *arena, Arena_Side side, size_t to) {
+    assert(arena->pos[side] >= to && "trying to pop forward");
+    arena->pos[side] = to;
+
+    size_t threshold = arena->decommitThreshold;
+    if (threshold != 0 && arena->committed[side] - to > threshold)
+        arena_dual_decommit(arena, side, arena->decommitKeep);
+}
+
+inline Arena_Dual_Temp arena_dual_temp_begin(Arena_Dual *arena, Arena_Side side) {
+    return { arena, side, arena->pos[side] };
+}
+inline void arena_dual_temp_end(Arena_Dual_Temp temp) {
+    arena_dual_pop_to(temp.arena, temp.side, temp.pos);
+}
+
+/*
+ *
+ */
+
+// compile time configured arena, the policy constants fold away on the push fast path:
+// growth:      Arena_Growth, applied at init. it only steers commits, which stay in arena_push_ex
+// flags:       ARENA_FLAG_* commit mode
+// boundsCheck: false commits the whole reservation at init. pushes never commit or chain,
+//              past the reservation they fail
+// stats:       count pushes in the arena's Basic_Arena_Stats
+// minAlign:    lower bound for every push alignment, power of 2
+
+struct Arena_Default_Policy {
+    static constexpr Arena_Growth growth = ARENA_GROWTH_FIXED;
+    static constexpr unsigned int flags = 0;
+    static constexpr bool boundsCheck = true;
+    static constexpr bool stats = false;
+    static constexpr size_t minAlign = 1;
+};
+
+struct Basic_Arena_Stats {
+    size_t pushCount;
+    size_t pushBytes;
+    size_t paddingBytes;    // lost to alignment
+};
+
+template <bool>
+struct _Basic_Arena_Stats {
+    void count(size_t, size_t) {}
+};
+template <>
+struct _Basic_Arena_Stats<true> {
+    Basic_Arena_Stats stats;
+
+    void count(size_t size, size_t padding) {
+        stats.pushCount++;
+        stats.pushBytes += size;
+        stats.paddingBytes += padding;
+    }
+};
+
+template <typename Policy = Arena_Default_Policy>
+struct Basic_Arena : _Basic_Arena_Stats<Policy::stats> {
+    static_assert(_is_pow2(Policy::minAlign), "minAlign must be non-zero power of 2");
+    static_assert(Policy::boundsCheck || !(Policy::flags & ARENA_FLAG_CHAINED),
+        "unchecked pushes can't chain");
+
+    Arena arena;
+};
+
+template <typename Policy = Arena_Default_Policy>
+inline Basic_Arena<Policy> basic_arena_init(
+    size_t reserveSize = ARENA_DEFAULT_RESERVE_SIZE,
+    size_t perCommitSize = ARENA_DEFAULT_PER_COMMIT_SIZE
+) {
+    Basic_Arena<Policy> res = {};
+    res.arena = arena_init(reserveSize, perCommitSize, Policy::flags);
+    if (res.arena.ptr == nullptr) return res;
+
+    if (Policy::growth != ARENA_GROWTH_FIXED)
+        arena_set_growth(&res.arena, Policy::growth);
+    if (!Policy::boundsCheck) {
+        // cheap with ARENA_FLAG_DEMAND_PAGED, one commit otherwise
+        if (arena_push_ex(&res.arena, res.arena.reserved, 1) == nullptr) {
+            arena_free(&res.arena);
+            return res;
+        }
+        arena_pop_to(&res.arena, 0);
+    }
+    return res;
+}
+
+template <typename Policy>
+inline void basic_arena_free(Basic_Arena<Policy> *arena) {
+    arena_free(&arena->arena);
+}
+
+template <typename Policy>
+inline size_t basic_arena_get_pos(const Basic_Arena<Policy> *arena) {
+    return arena_get_pos(&arena->arena);
+}
+
+// keep decommit off on unchecked arenas, pops must not give the reservation back
+template <typename Policy>
+inline void basic_arena_pop_to(Basic_Arena<Policy> *arena, size_t to) {
+    arena_pop_to(&arena->arena, to);
+}
+
+// commits, chaining and ARENA_STATS/ARENA_TRACE only happen in arena_push_ex
+template <typename Policy>
+inline void *basic_arena_push_ex(Basic_Arena<Policy> *arena, size_t size, size_t align) {
+    constexpr size_t minAlign = Policy::minAlign;
+    align = align > minAlign ? align : minAlign;
+    Arena *base = &arena->arena;
+
+    size_t addr = reinterpret_cast<size_t>(base->ptr);
+    size_t lastPos = _alignup_pow2(addr + base->pos, align) - addr;
+    size_t postPos = lastPos + size;
+    size_t padding = lastPos - base->pos;
+    if (_unlikely(postPos > base->committed)) {
+        if (!Policy::boundsCheck) {
+            assert(false && "unchecked push past the reservation");
+            return nullptr;
+        }
+        void *ptr = arena_push_ex(base, size, align);
+        if (ptr != nullptr) arena->count(size, padding);
+        return ptr;
+    }
+
+    arena->count(size, padding);
+    base->pos = postPos;
+    return reinterpret_cast<void *>(addr + lastPos);
+}
+
+template <typename T, typename Policy>
+inline T *basic_arena_push(Basic_Arena<Policy> *arena, size_t count = 1) {
+    void *ptr = basic_arena_push_ex(arena, sizeof(T) * count, alignof(T));
+    return static_cast<T *>(ptr);
+}
+
+// N bytes of member/stack storage, no syscalls. pushes that don't fit go to the backing arena
+// and live until it pops them, without one they fail
+template <size_t N>
+struct Inline_Arena {
+    alignas(max_align_t) char buffer[N];
+    size_t pos;
+    Arena *backing;
+};
+
+template <size_t N>
+inline void inline_arena_init(Inline_Arena<N> *arena, Arena *backing = nullptr) {
+    arena->pos = 0;
+    arena->backing = backing;
+}
+
+// pos within the inline storage only
+template <size_t N>
+inline size_t inline_arena_get_pos(const Inline_Arena<N> *arena) {
+    return arena->pos;
+}
+template <size_t N>
+inline void inline_arena_pop_to(Inline_Arena<N> *arena, size_t to) {
+    assert(arena->pos >= to && "trying to pop forward");
+    arena->pos = to;
+}
+
+template <size_t N>
+inline void *inline_arena_push_ex(Inline_Arena<N> *arena, size_t size, size_t align) {
+    assert(_is_pow2(align) && "alignment must be non-zero power of 2");
+    size_t addr = reinterpret_cast<size_t>(arena->buffer);
+    size_t lastPos = _alignup_pow2(addr + arena->pos, align) - addr;
+    if (lastPos + size <= N) {
+        arena->pos = lastPos + size;
+        return arena->buffer + lastPos;
+    }
+
+    if (arena->backing == nullptr) return nullptr;
+    return arena_push_ex(arena->backing, size, align);
+}
+
+template <typename T, size_t N>
+inline T *inline_arena_push(Inline_Arena<N> *arena, size_t count = 1) {
+    void *ptr = inline_arena_push_ex(arena, sizeof(T) * count, alignof(T));
+    return static_cast<T *>(ptr);
+}
+
+/*
+ *
+ */
+
+struct _Scratch {
+    Arena arena;
+#if ARENA_STATS
+    size_t beginCount;
+#endif
+};
+
+constexpr unsigned int PER_THREAD_SCRATCH_COUNT = ARENA_SCRATCH_COUNT;
+constexpr size_t SCRATCH_RESERVE_SIZE =
+    ARENA_SCRATCH_RESERVE_SIZE != 0 ? ARENA_SCRATCH_RESERVE_SIZE : ARENA_DEFAULT_RESERVE_SIZE;
+static_assert(PER_THREAD_SCRATCH_COUNT >= 1 && PER_THREAD_SCRATCH_COUNT <= 32, "scratch count must be in [1, 32]");
+
+inline void scratches_free();
+
+// slots are reserved on first use and released with the thread
+struct _Scratches {
+    _Scratch slots[PER_THREAD_SCRATCH_COUNT];
+    uint32_t inUse;     // bit per slot
+
+    ~_Scratches() { scratches_free(); }
+};
+static thread_local _Scratches _scratches = {};
+
+constexpr uint32_t _SCRATCH_ALL_MASK = uint32_t(~uint64_t(0) >> (64 - PER_THREAD_SCRATCH_COUNT));
+
+// slot of a scratch arena, PER_THREAD_SCRATCH_COUNT for other arenas
+inline unsigned int _scratch_index(const Arena *arena) {
+    uintptr_t offset = reinterpret_cast<uintptr_t>(arena) - reinterpret_cast<uintptr_t>(_scratches.slots);
+    if (offset >= sizeof(_scratches.slots) || offset % sizeof(_Scratch) != 0) return PER_THREAD_SCRATCH_COUNT;
+    return static_cast<unsigned int>(offset / sizeof(_Scratch));
+}
+
+inline Arena_Temp _scratch_begin_masked(uint32_t conflictMask, const void *site) {
+    uint32_t freeMask = ~(_scratches.inUse | conflictMask) & _SCRATCH_ALL_MASK;
+    if (freeMask == 0) {
+        assert(false && "all scratch arenas in use");
+        return {};
+    }
+
+    unsigned int i = _ctz64(freeMask);
+    _Scratch *slot = &_scratches.slots[i];
+    if (slot->arena.ptr == nullptr) {
+        slot->arena = arena_init(SCRATCH_RESERVE_SIZE);
+        if (slot->arena.ptr == nullptr) return {};
+    }
+
+    _scratches.inUse |= uint32_t(1) << i;
+#if ARENA_STATS
+    slot->beginCount++;
+#endif
+    Arena_Temp scratch = { &slot->arena, arena_get_pos(&slot->arena) };
+    _arena_trace(ARENA_TRACE_SCRATCH_BEGIN, scratch.arena, 0, scratch.pos, site);
+    return scratch;
+}
+
+_TRACE_ENTRY inline Arena_Temp scratch_begin() {
+    return _scratch_begin_masked(0, _trace_site());
+}
+
+// never returns one of the conflicting arenas, pass the arenas the caller is still pushing into
+template <typename... Conflicts>
+_TRACE_ENTRY inline Arena_Temp scratch_begin(Conflicts... conflicts) {
+    const Arena *arenas[] = { conflicts... };
+
+    uint32_t conflictMask = 0;
+    for (const Arena *arena : arenas) {
+        unsigned int i = _scratch_index(arena);
+        if (i < PER_THREAD_SCRATCH_COUNT) conflictMask |= uint32_t(1) << i;
+    }
+    return _scratch_begin_masked(conflictMask, _trace_site());
+}
+
+_TRACE_ENTRY inline bool scratch_end(Arena_Temp scratch) {
+    unsigned int i = _scratch_index(scratch.arena);
+    if (i >= PER_THREAD_SCRATCH_COUNT) {
+        assert(false && "non-scratch argument passed");
+        return false;
+    }
+
+    _scratches.inUse &= ~(uint32_t(1) << i);
+    arena_pop_to(scratch.arena, scratch.pos);
+    _arena_trace(ARENA_TRACE_SCRATCH_END, scratch.arena, 0, scratch.pos, _trace_site());
+    return true;
+}
+
+// scratch_end() on scope exit, move-only
+struct Scratch_Scope {
+    Arena_Temp scratch;
+
+    template <typename... Conflicts>
+    _TRACE_INLINE explicit Scratch_Scope(Conflicts *...conflicts) : scratch(scratch_begin(conflicts...)) {}
+    Scratch_Scope(Scratch_Scope &&other) noexcept : scratch(other.scratch) { other.scratch.arena = nullptr; }
+    Scratch_Scope &operator=(Scratch_Scope &&other) noexcept {
+        if (this != &other) {
+            if (scratch.arena != nullptr) scratch_end(scratch);
+            scratch = other.scratch;
+            other.scratch.arena = nullptr;
+        }
+        return *this;
+    }
+    Scratch_Scope(const Scratch_Scope &) = delete;
+    Scratch_Scope &operator=(const Scratch_Scope &) = delete;
+    _TRACE_INLINE ~Scratch_Scope() {
+        if (scratch.arena != nullptr) scratch_end(scratch);
+    }
+
+    // null when every scratch arena is in use
+    Arena *arena() const { return scratch.arena; }
+};
+
+// gives committed pages above each scratch's pos back to the OS, the reservations stay.
+// call from threads that go idle after a burst
+inline void scratches_decommit() {
+    for (unsigned int i = 0; i < PER_THREAD_SCRATCH_COUNT; i++) {
+        if (_scratches.slots[i].arena.ptr != nullptr)
+            arena_decommit(&_scratches.slots[i].arena);
+    }
+}
+
+inline void scratches_free() {
+    for (unsigned int i = 0; i < PER_THREAD_SCRATCH_COUNT; i++) {
+        if (_scratches.slots[i].arena.ptr != nullptr)
+            arena_free(&_scratches.slots[i].arena);
+    }
+    _scratches.inUse = 0;
+}
+
+#if ARENA_STATS
+
+inline const Arena_Stats *arena_get_stats(const Arena *arena) {
+    return &arena->stats;
+}
+
+inline void arena_stats_dump(const Arena *arena, FILE *file) {
+    const Arena_Stats *stats = &arena->stats;
+    fprintf(file, "arena %p: pos %zu, peak pos %zu, committed %zu, reserved %zu, per commit %zu\n",
+        arena->ptr, arena_get_pos(arena), stats->peakPos, arena->committed, arena->reserved, arena->perCommitSize);
+    fprintf(file, "  commits: %zu (%zu bytes), decommits: %zu (%zu bytes)\n",
+        stats->commitCount, stats->commitBytes, stats->decommitCount, stats->decommitBytes);
+    fprintf(file, "  pushes: %zu, alignment padding: %zu bytes\n",
+        stats->pushCount, stats->paddingBytes);
+
+    for (unsigned int i = 0; i < ARENA_STATS_BUCKET_COUNT; i++) {
+        if (stats->pushBuckets[i] == 0) continue;
+        if (i + 1 < ARENA_STATS_BUCKET_COUNT)
+            fprintf(file, "  size [%zu, %zu): %zu\n", size_t(1) << i, size_t(1) << (i + 1), stats->pushBuckets[i]);
+        else
+            fprintf(file, "  size [%zu, ...): %zu\n", size_t(1) << i, stats->pushBuckets[i]);
+    }
+}
+
+// current thread's scratches
+inline void scratches_stats_dump(FILE *file) {
+    for (unsigned int i = 0; i < PER_THREAD_SCRATCH_COUNT; i++) {
+        const _Scratch *slot = &_scratches.slots[i];
+        if (slot->arena.ptr == nullptr) continue;
+        fprintf(file, "scratch %u: begins %zu, in use %d\n", i, slot->beginCount, int(_scratches.inUse >> i & 1));
+        arena_stats_dump(&slot->arena, file);
+    }
+}
+
+#endif  // ARENA_STATS
+
+/*
+ *
+ */
+
+// fixed size object pool, slabs are carved out of an arena
+// https://medium.com/@tom_84912/object-allocators-%E1%B4%99-us-dc0edda80c58
+
+constexpr size_t POOL_DEFAULT_SLAB_SIZE = kilobytes(64);
+
+struct _Pool_Slab {
+    _Pool_Slab *nextFree;   // next slab with free slots
+    size_t freeCount;
+    size_t hint;            // lowest bitmap word that may have a free slot
+    // uint64_t bitmap[wordCount], set bit means slot in use
+    // slots start at slotsOffset
+};
+
+struct Pool {
+    Arena *arena;
+    _Pool_Slab *freeSlabs;
+    size_t slotSize;
+    size_t slotCount;       // per slab
+    size_t slotsOffset;
+    size_t wordCount;
+    size_t slabSize;
+};
+
+// slabs are aligned to slabSize, so freeing finds its slab with a mask.
+// slabs live until the arena pops below them, pool must not outlive that
+inline Pool pool_init_ex(
+    Arena *arena, size_t size, size_t align,
+    size_t slabSize = POOL_DEFAULT_SLAB_SIZE
+) {
+    assert(_is_pow2(align) && "alignment must be non-zero power of 2");
+    assert(_is_pow2(slabSize) && "slab size must be power of 2");
+
+    size_t slotSize = _alignup_pow2(size != 0 ? size : 1, align);
+    size_t header = sizeof(_Pool_Slab);
+
+    // every slot costs slotSize bytes and 1 bit
+    size_t slotCount = (slabSize - header) * 8 / (slotSize * 8 + 1);
+    size_t wordCount, slotsOffset;
+    for (;;) {
+        wordCount = (slotCount + 63) / 64;
+        slotsOffset = _alignup_pow2(header + wordCount * sizeof(uint64_t), align);
+        if (slotsOffset + slotCount * slotSize <= slabSize) break;
+        slotCount--;
+    }
+    assert(slotCount != 0 && "slab size too small for the object");
+
+    Pool res = {};
+    res.arena = arena;
+    res.slotSize = slotSize;
+    res.slotCount = slotCount;
+    res.slotsOffset = slotsOffset;
+    res.wordCount = wordCount;
+    res.slabSize = slabSize;
+    return res;
+}
+
+inline _Pool_Slab *_pool_slab_new(Pool *pool) {
+    void *ptr = arena_push_ex(pool->arena, pool->slabSize, pool->slabSize);
+    if (ptr == nullptr) return nullptr;
+
+    auto slab = static_cast<_Pool_Slab *>(ptr);
+    slab->nextFree = nullptr;
+    slab->freeCount = pool->slotCount;
+    slab->hint = 0;
+
+    // memory may be reused after a pop, clear explicitly
+    auto bitmap = reinterpret_cast<uint64_t *>(slab + 1);
+    for (size_t i = 0; i < pool->wordCount; i++)
+        bitmap[i] = 0;
+
+    // mark the tail of the last word as used, scans never pick them
+    size_t tail = pool->slotCount % 64;
+    if (tail != 0)
+        bitmap[pool->wordCount - 1] = ~0ull << tail;
+
+    pool->freeSlabs = slab;
+    return slab;
+}
+
+// returned memory is not zeroed
+inline void *pool_alloc_ex(Pool *pool) {
+    _Pool_Slab *slab = pool->freeSlabs;
+    if (slab == nullptr) {
+        slab = _pool_slab_new(pool);
+        if (slab == nullptr) return nullptr;
+    }
+
+    // freeCount != 0, a free bit exists at or after the hint
+    auto bitmap = reinterpret_cast<uint64_t *>(slab + 1);
+    size_t word = slab->hint;
+    while (bitmap[word] == ~0ull)
+        word++;
+    unsigned int bit = _ctz64(~bitmap[word]);
+    bitmap[word] |= 1ull << bit;
+    slab->hint = word;
+
+    if (--slab->freeCount == 0) {
+        pool->freeSlabs = slab->nextFree;
+        slab->nextFree = nullptr;
+    }
+
+    size_t slot = word * 64 + bit;
+    return reinterpret_cast<char *>(slab) + pool->slotsOffset + slot * pool->slotSize;
+}
+
+inline void pool_free(Pool *pool, void *ptr) {
+    if (ptr == nullptr) return;
+
+    size_t addr = reinterpret_cast<size_t>(ptr);
+    auto slab = reinterpret_cast<_Pool_Slab *>(addr & ~(pool->slabSize - 1));
+
+    size_t slot = (addr - reinterpret_cast<size_t>(slab) - pool->slotsOffset) / pool->slotSize;
+    size_t word = slot / 64;
+    uint64_t mask = 1ull << (slot % 64);
+
+    auto bitmap = reinterpret_cast<uint64_t *>(slab + 1);
+    assert((bitmap[word] & mask) != 0 && "double free");
+    bitmap[word] &= ~mask;
+    if (word < slab->hint) slab->hint = word;
+
+    // full slabs are not listed, relink on first free
+    if (slab->freeCount++ == 0) {
+        slab->nextFree = pool->freeSlabs;
+        pool->freeSlabs = slab;
+    }
+}
+
+template <typename T>
+inline Pool pool_init(Arena *arena, size_t slabSize = POOL_DEFAULT_SLAB_SIZE) {
+    return pool_init_ex(arena, sizeof(T), alignof(T), slabSize);
+}
+template <typename T>
+inline T *pool_alloc(Pool *pool) {
+    assert(sizeof(T) <= pool->slotSize && "object too big for the pool");
+    return static_cast<T *>(pool_alloc_ex(pool));
+}
+
+/*
+ *
+ */
+
+// pops the block when it is the last thing pushed, otherwise a no-op
+inline bool _arena_pop_top(Arena *arena, void *ptr, size_t size) {
+    char *base = static_cast<char *>(arena->ptr);
+    if (static_cast<char *>(ptr) + size != base + arena->pos) return false;
+
+    arena_pop_to(arena, arena->basePos + (static_cast<char *>(ptr) - base));
+    return true;
+}
+
+// allocators can't return null, throw or die when the arena is out of room
+[[noreturn]] inline void _arena_bad_alloc() {
+#if _HAS_EXCEPTIONS
+    throw std::bad_alloc();
+#else
+    std::terminate();
+#endif
+}
+
+// std allocator over an arena, deallocation only reclaims the top block
+template <typename T>
+struct Arena_Allocator {
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    Arena *arena;
+
+    Arena_Allocator(Arena *arena) : arena(arena) {}
+    template <typename U>
+    Arena_Allocator(const Arena_Allocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t count) {
+        if (count > SIZE_MAX / sizeof(T)) _arena_bad_alloc();
+        T *ptr = arena_push<T>(arena, count);
+        if (ptr == nullptr) _arena_bad_alloc();
+        return ptr;
+    }
+    void deallocate(T *ptr, size_t count) {
+        _arena_pop_top(arena, ptr, sizeof(T) * count);
+    }
+};
+
+template <typename T, typename U>
+inline bool operator==(const Arena_Allocator<T> &a, const Arena_Allocator<U> &b) { return a.arena == b.arena; }
+template <typename T, typename U>
+inline bool operator!=(const Arena_Allocator<T> &a, const Arena_Allocator<U> &b) { return a.arena != b.arena; }
+
+#if _HAS_PMR
+
+struct Arena_Resource : std::pmr::memory_resource {
+    Arena *arena;
+
+    explicit Arena_Resource(Arena *arena) : arena(arena) {}
+    explicit Arena_Resource(Arena_Temp temp) : arena(temp.arena) {}
+
+protected:
+    void *do_allocate(size_t size, size_t align) override {
+        void *ptr = arena_push_ex(arena, size, align);
+        if (ptr == nullptr) _arena_bad_alloc();
+        return ptr;
+    }
+    void do_deallocate(void *ptr, size_t size, size_t) override {
+        _arena_pop_top(arena, ptr, size);
+    }
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        auto res = dynamic_cast<const Arena_Resource *>(&other);
+        return res != nullptr && res->arena == arena;
+    }
+};
+
+// holds a scratch for its lifetime
+struct Scratch_Resource : Arena_Resource {
+    Arena_Temp scratch;
+
+    Scratch_Resource() : Arena_Resource(nullptr), scratch(scratch_begin()) {
+        if (scratch.arena == nullptr) _arena_bad_alloc();
+        arena = scratch.arena;
+    }
+    ~Scratch_Resource() { scratch_end(scratch); }
+
+    Scratch_Resource(const Scratch_Resource &) = delete;
+    Scratch_Resource &operator=(const Scratch_Resource &) = delete;
+};
+
+#endif  // _HAS_PMR
+
+/*
+ *
+ */
+
+// growable array, grows in place while it is the last push.
+// elements are moved with memcpy
+template <typename T>
+struct Arena_Array {
+    Arena *arena;
+    T *ptr;
+    size_t len;
+    size_t cap;
+};
+
+template <typename T>
+inline bool arena_array_reserve(Arena_Array<T> *array, size_t cap) {
+    static_assert(std::is_trivially_copyable<T>::value, "array elements are moved with memcpy");
+    if (cap <= array->cap) return true;
+
+    size_t newCap = array->cap * 2;
+    newCap = newCap > cap ? newCap : cap;
+
+    T *ptr = arena_realloc<T>(array->arena, array->ptr, array->cap, newCap);
+    if (ptr == nullptr) return false;
+
+    array->ptr = ptr;
+    array->cap = newCap;
+    return true;
+}
+
+template <typename T>
+inline Arena_Array<T> arena_array_init(Arena *arena, size_t cap = 0) {
+    Arena_Array<T> res = { arena, nullptr, 0, 0 };
+    if (cap != 0) arena_array_reserve(&res, cap);
+    return res;
+}
+
+// returns the first of count new elements, not zeroed
+template <typename T>
+inline T *arena_array_push(Arena_Array<T> *array, size_t count = 1) {
+    if (!arena_array_reserve(array, array->len + count)) return nullptr;
+
+    T *res = array->ptr + array->len;
+    array->len += count;
+    return res;
+}
+
+template <typename T>
+inline void arena_array_pop(Arena_Array<T> *array, size_t count = 1) {
+    assert(array->len >= count && "popping more than the array has");
+    array->len -= count;
+}
+
+// gives unused capacity back when the array is the last push
+template <typename T>
+inline void arena_array_fit(Arena_Array<T> *array) {
+    if (arena_extend(array->arena, array->ptr, sizeof(T) * array->cap, sizeof(T) * array->len))
+        array->cap = array->len;
+}
+
+/*
+ *
+ */
+
+// open addressing hash map with linear probing and backward shift deletion.
+// the table grows when 3/4 full, in place while it is the last push,
+// otherwise into a new push and the old one stays behind
+
+constexpr size_t ARENA_MAP_DEFAULT_CAP = 16;
+
+template <typename K, typename V>
+struct _Arena_Map_Slot {
+    K key;
+    V value;
+    bool used;
+};
+
+template <typename K, typename V, typename Hash = std::hash<K>>
+struct Arena_Map {
+    Arena *arena;
+    _Arena_Map_Slot<K, V> *slots;
+    size_t count;
+    size_t cap;     // power of 2
+};
+
+template <typename K, typename V, typename Hash>
+inline size_t _arena_map_index(const Arena_Map<K, V, Hash> *map, const K &key) {
+    // fibonacci hashing, std::hash is identity for integers
+    uint64_t h = static_cast<uint64_t>(Hash()(key)) * 11400714819323198485ull;
+    return static_cast<size_t>(h >> (64 - _bsr64(map->cap)));
+}
+
+template <typename K, typename V, typename Hash>
+inline bool _arena_map_grow(Arena_Map<K, V, Hash> *map, size_t cap) {
+    using Slot = _Arena_Map_Slot<K, V>;
+    static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+        "map keys and values are moved with memcpy");
+
+    Slot *slots = map->slots;
+    Slot *oldSlots = map->slots;
+    size_t oldCap = map->cap;
+    Arena_Temp scratch = {};
+    if (slots != nullptr && arena_extend(map->arena, slots, sizeof(Slot) * oldCap, sizeof(Slot) * cap)) {
+        // grown in place, rehash from a copy of the old entries
+        scratch = scratch_begin(map->arena);
+        oldSlots = scratch.arena != nullptr ? arena_push<Slot>(scratch.arena, oldCap) : nullptr;
+        if (oldSlots == nullptr) {
+            arena_extend(map->arena, slots, sizeof(Slot) * cap, sizeof(Slot) * oldCap);
+            if (scratch.arena != nullptr) scratch_end(scratch);
+            return false;
+        }
+        memcpy(oldSlots, slots, sizeof(Slot) * oldCap);
+    } else {
+        slots = arena_push<Slot>(map->arena, cap);
+        if (slots == nullptr) return false;
+    }
+    // memory may be reused after a pop, clear explicitly
+    memset(slots, 0, sizeof(Slot) * cap);
+
+    map->slots = slots;
+    map->cap = cap;
+
+    for (size_t i = 0; i < oldCap; i++) {
+        if (!oldSlots[i].used) continue;
+
+        size_t mask = cap - 1;
+        size_t idx = _arena_map_index(map, oldSlots[i].key);
+        while (slots[idx].used)
+            idx = (idx + 1) & mask;
+        slots[idx] = oldSlots[i];
+    }
+    if (scratch.arena != nullptr) scratch_end(scratch);
+    return true;
+}
+
+// cap stays 0 when the table can't be pushed, the first put retries
+template <typename K, typename V, typename Hash = std::hash<K>>
+inline Arena_Map<K, V, Hash> arena_map_init(Arena *arena, size_t cap = ARENA_MAP_DEFAULT_CAP) {
+    Arena_Map<K, V, Hash> res = { arena, nullptr, 0, 0 };
+    cap = cap > 2 ? cap : 2;
+    _arena_map_grow(&res, size_t(1) << (_bsr64(cap - 1) + 1));
+    return res;
+}
+
+template <typename K, typename V, typename Hash>
+inline V *arena_map_get(Arena_Map<K, V, Hash> *map, const K &key) {
+    if (map->cap == 0) return nullptr;
+
+    size_t mask = map->cap - 1;
+    for (size_t idx = _arena_map_index(map, key); map->slots[idx].used; idx = (idx + 1) & mask) {
+        if (map->slots[idx].key == key) return &map->slots[idx].value;
+    }
+    return nullptr;
+}
+
+// returns the value for key, inserted zeroed when missing
+template <typename K, typename V, typename Hash>
+inline V *arena_map_put(Arena_Map<K, V, Hash> *map, const K &key) {
+    size_t mask = map->cap - 1;
+    size_t idx = 0;
+    if (map->cap != 0) {
+        idx = _arena_map_index(map, key);
+        for (; map->slots[idx].used; idx = (idx + 1) & mask) {
+            if (map->slots[idx].key == key) return &map->slots[idx].value;
+        }
+    }
+
+    // a new key, grow first when it would pass the load factor
+    if (map->cap == 0 || (map->count + 1) * 4 > map->cap * 3) {
+        size_t cap = map->cap != 0 ? map->cap * 2 : ARENA_MAP_DEFAULT_CAP;
+        if (!_arena_map_grow(map, cap)) return nullptr;
+
+        mask = map->cap - 1;
+        idx = _arena_map_index(map, key);
+        while (map->slots[idx].used)
+            idx = (idx + 1) & mask;
+    }
+
+    map->slots[idx].key = key;
+    map->slots[idx].used = true;
+    map->count++;
+    return &map->slots[idx].value;
+}
+
+template <typename K, typename V, typename Hash>
+inline bool arena_map_remove(Arena_Map<K, V, Hash> *map, const K &key) {
+    using Slot = _Arena_Map_Slot<K, V>;
+    if (map->cap == 0) return false;
+
+    size_t mask = map->cap - 1;
+    size_t idx = _arena_map_index(map, key);
+    for (;; idx = (idx + 1) & mask) {
+        if (!map->slots[idx].used) return false;
+        if (map->slots[idx].key == key) break;
+    }
+
+    // shift back the following entries that probed past the hole
+    size_t hole = idx;
+    for (size_t next = (hole + 1) & mask; map->slots[next].used; next = (next + 1) & mask) {
+        size_t home = _arena_map_index(map, map->slots[next].key);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            map->slots[hole] = map->slots[next];
+            hole = next;
+        }
+    }
+
+    map->slots[hole] = Slot();
+    map->count--;
+    return true;
+}
+
+/*
+ *
+ */
+
+// position independent data, stays valid when the arena image is copied,
+// mapped at another address (arena_file_open) or shared between processes.
+// base relative offsets need the arena, self relative pointers only themselves
+
+inline size_t arena_offset_of(const Arena *arena, const void *ptr) {
+    assert(arena->prev == nullptr && "chained arenas aren't one image");
+    return static_cast<size_t>(static_cast<const char *>(ptr) - static_cast<const char *>(arena->ptr));
+}
+
+template <typename T = void>
+inline T *arena_ptr_at(const Arena *arena, size_t offset) {
+    return reinterpret_cast<T *>(static_cast<char *>(arena->ptr) + offset);
+}
+
+// offset from its own address, 0 is null.
+// copies re-anchor, so a copy to another place still points at the same target
+template <typename T>
+struct Rel_Ptr {
+    intptr_t offset;
+
+    Rel_Ptr() : offset(0) {}
+    Rel_Ptr(T *ptr) { set(ptr); }
+    Rel_Ptr(const Rel_Ptr &other) { set(other.get()); }
+
+    Rel_Ptr &operator=(const Rel_Ptr &other) { set(other.get()); return *this; }
+    Rel_Ptr &operator=(T *ptr) { set(ptr); return *this; }
+
+    T *get() const {
+        if (offset == 0) return nullptr;
+        return reinterpret_cast<T *>(reinterpret_cast<intptr_t>(this) + offset);
+    }
+    void set(T *ptr) {
+        offset = ptr != nullptr ? reinterpret_cast<intptr_t>(ptr) - reinterpret_cast<intptr_t>(this) : 0;
+    }
+
+    T *operator->() const { return get(); }
+    T &operator*() const { return *get(); }
+    T &operator[](size_t index) const { return get()[index]; }
+    explicit operator bool() const { return offset != 0; }
+};
+
+// moves elements to a new block, Rel_Ptr members are copied so they re-anchor
+template <typename T>
+inline void _rel_relocate(T *dst, const T *src, size_t count) {
+    if (std::is_trivially_copyable<T>::value) {
+        if (count != 0) memcpy(static_cast<void *>(dst), static_cast<const void *>(src), sizeof(T) * count);
+        return;
+    }
+    for (size_t i = 0; i < count; i++)
+        new (dst + i) T(src[i]);
+}
+
+// growable array stored inside the arena it grows in, the arena is passed on every grow
+template <typename T>
+struct Rel_Array {
+    Rel_Ptr<T> ptr;
+    size_t len;
+    size_t cap;
+
+    T &operator[](size_t index) const { return ptr.get()[index]; }
+    T *begin() const { return ptr.get(); }
+    T *end() const { return ptr.get() + len; }
+};
+
+template <typename T>
+inline bool rel_array_reserve(Arena *arena, Rel_Array<T> *array, size_t cap) {
+    static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destructed");
+    if (cap <= array->cap) return true;
+
+    size_t newCap = array->cap * 2;
+    newCap = newCap > cap ? newCap : cap;
+
+    T *old = array->ptr.get();
+    if (old != nullptr && arena_extend(arena, old, sizeof(T) * array->cap, sizeof(T) * newCap)) {
+        array->cap = newCap;
+        return true;
+    }
+
+    T *ptr = arena_push<T>(arena, newCap);
+    if (ptr == nullptr) return false;
+    _rel_relocate(ptr, old, array->len);
+
+    array->ptr = ptr;
+    array->cap = newCap;
+    return true;
+}
+
+// returns the first of count new elements, not zeroed
+template <typename T>
+inline T *rel_array_push(Arena *arena, Rel_Array<T> *array, size_t count = 1) {
+    if (!rel_array_reserve(arena, array, array->len + count)) return nullptr;
+
+    T *res = array->ptr.get() + array->len;
+    array->len += count;
+    return res;
+}
+
+struct Rel_Str {
+    Rel_Ptr<char> ptr;
+    size_t len;
+};
+
+inline Arena_Str rel_str_get(const Rel_Str *str) {
+    return { str->ptr.get(), str->len };
+}
+
+// points at str, which must live in the same image
+inline void rel_str_set(Rel_Str *dst, Arena_Str str) {
+    dst->ptr = str.ptr;
+    dst->len = str.len;
+}
@@ -0,0 +1,312 @@
+// g++ -std=c++17 -O2 -pthread bench.cpp -o bench
+// prints one json object per line
+
+#include "arena.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#if _IS_OS_LINUX
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#endif
+
+static void *volatile benchSink;
+
+static double now_ns() {
+    auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(t).count());
+}
+
+static void report(
+    const char *bench, const char *variant,
+    size_t size, size_t align, unsigned int threads, size_t ops, double ns
+) {
+    printf(
+        "{\"suite\":\"cpp11\",\"bench\":\"%s\",\"variant\":\"%s\",\"size\":%zu,\"align\":%zu,"
+        "\"threads\":%u,\"ops\":%zu,\"ns_per_op\":%.3f}\n",
+        bench, variant, size, align, threads, ops, ns / ops
+    );
+}
+
+#if _IS_OS_LINUX
+
+// user space instructions retired, -1 when perf events are unavailable
+static int counter_open() {
+    perf_event_attr attr = {};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+static void counter_start(int fd) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+// skips the report when the count can't be read
+static void counter_report(int fd, const char *bench, const char *variant, size_t size, size_t ops) {
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t count = 0;
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) return;
+    printf(
+        "{\"suite\":\"cpp11\",\"bench\":\"%s\",\"variant\":\"%s\",\"size\":%zu,"
+        "\"ops\":%zu,\"instructions_per_op\":%.3f}\n",
+        bench, variant, size, ops, static_cast<double>(count) / ops
+    );
+}
+
+#endif
+
+/*
+ *
+ */
+
+constexpr size_t PUSH_OPS = 1u << 20;
+constexpr size_t PUSH_BYTES = megabytes(256);
+
+static void bench_push(size_t size, size_t align) {
+    size_t ops = PUSH_BYTES / (size + align);
+    ops = ops < PUSH_OPS ? ops : PUSH_OPS;
+
+    auto arena = arena_init(PUSH_BYTES);
+    // warm up the commits, only the bump is measured
+    arena_push_ex(&arena, (size + align) * ops, 1);
+    arena_pop_to(&arena, 0);
+
+    double t0 = now_ns();
+    for (size_t i = 0; i < ops; i++)
+        benchSink = arena_push_ex(&arena, size, align);
+    report("push", "arena", size, align, 1, ops, now_ns() - t0);
+    arena_pop_to(&arena, 0);
+
+    t0 = now_ns();
+    auto cursor = arena_cursor_begin(&arena, (size + align) * ops);
+    for (size_t i = 0; i < ops; i++)
+        benchSink = arena_cursor_push_ex(&cursor, size, align);
+    arena_cursor_end(cursor);
+    report("push", "cursor", size, align, 1, ops, now_ns() - t0);
+    arena_free(&arena);
+
+    // malloc then free in the same order
+    std::vector<void *> ptrs(ops);
+    t0 = now_ns();
+    for (size_t i = 0; i < ops; i++)
+        ptrs[i] = malloc(size);
+    for (size_t i = 0; i < ops; i++)
+        free(ptrs[i]);
+    report("push", "malloc_batch", size, align, 1, ops, now_ns() - t0);
+
+    // size class free list reuse, the common case jemalloc/tcmalloc optimize for
+    t0 = now_ns();
+    for (size_t i = 0; i < ops; i++) {
+        void *ptr = malloc(size);
+        benchSink = ptr;
+        free(ptr);
+    }
+    report("push", "malloc_pair", size, align, 1, ops, now_ns() - t0);
+
+#if _HAS_PMR
+    std::pmr::monotonic_buffer_resource mono((size + align) * ops);
+    t0 = now_ns();
+    for (size_t i = 0; i < ops; i++)
+        benchSink = mono.allocate(size, align);
+    report("push", "pmr_monotonic", size, align, 1, ops, now_ns() - t0);
+#endif
+}
+
+#if _IS_OS_LINUX
+
+// the push before the hot/cold split, the baseline for the arena variant
+__attribute__((always_inline)) inline void *push_unsplit(Arena *arena, size_t size, size_t align) {
+    size_t base = reinterpret_cast<size_t>(arena->ptr);
+    size_t lastPos = _alignup_pow2(base + arena->pos, align) - base;
+    size_t postPos = lastPos + size;
+
+    if (postPos > arena->committed)
+        return _arena_push_commit(arena, size, align, lastPos, postPos, nullptr);
+    return _arena_push_bump(arena, size, lastPos, postPos, nullptr);
+}
+
+// flatten pulls the commit path into the loop, as the unsplit push did at every call site
+__attribute__((flatten)) static void push_loop_unsplit(Arena *arena, size_t size, size_t ops) {
+    for (size_t i = 0; i < ops; i++)
+        benchSink = push_unsplit(arena, size, 8);
+}
+
+// the push fast path inlines to a compare and a bump, the commit path stays out of line
+static void bench_push_instructions(int fd, size_t size) {
+    size_t ops = PUSH_OPS;
+    auto arena = arena_init(size * ops);
+
+    // includes the commits, user space side only
+    counter_start(fd);
+    for (size_t i = 0; i < ops; i++)
+        benchSink = arena_push_ex(&arena, size, 8);
+    counter_report(fd, "push_instructions", "arena_growth", size, ops);
+    arena_pop_to(&arena, 0);
+
+    counter_start(fd);
+    for (size_t i = 0; i < ops; i++)
+        benchSink = arena_push_ex(&arena, size, 8);
+    counter_report(fd, "push_instructions", "arena", size, ops);
+    arena_pop_to(&arena, 0);
+
+    counter_start(fd);
+    push_loop_unsplit(&arena, size, ops);
+    counter_report(fd, "push_instructions", "arena_unsplit", size, ops);
+    arena_pop_to(&arena, 0);
+
+    counter_start(fd);
+    auto cursor = arena_cursor_begin(&arena, size * ops);
+    for (size_t i = 0; i < ops; i++)
+        benchSink = arena_cursor_push_ex(&cursor, size, 8);
+    arena_cursor_end(cursor);
+    counter_report(fd, "push_instructions", "cursor", size, ops);
+    arena_free(&arena);
+
+    counter_start(fd);
+    for (size_t i = 0; i < ops; i++) {
+        void *ptr = malloc(size);
+        benchSink = ptr;
+        free(ptr);
+    }
+    counter_report(fd, "push_instructions", "malloc_pair", size, ops);
+}
+
+#endif
+
+constexpr size_t TEMP_OPS = 1u << 22;
+
+static void bench_temp() {
+    auto arena = arena_init();
+
+    double t0 = now_ns();
+    for (size_t i = 0; i < TEMP_OPS; i++) {
+        auto temp = arena_temp_begin(&arena);
+        benchSink = arena_push<char>(&arena, 64);
+        arena_temp_end(temp);
+    }
+    report("temp_round_trip", "arena", 64, 1, 1, TEMP_OPS, now_ns() - t0);
+    arena_free(&arena);
+
+    t0 = now_ns();
+    for (size_t i = 0; i < TEMP_OPS; i++) {
+        auto scratch = scratch_begin();
+        benchSink = arena_push<char>(scratch.arena, 64);
+        scratch_end(scratch);
+    }
+    report("scratch_round_trip", "arena", 64, 1, 1, TEMP_OPS, now_ns() - t0);
+    scratches_free();
+
+    t0 = now_ns();
+    for (size_t i = 0; i < TEMP_OPS; i++) {
+        void *ptr = malloc(64);
+        benchSink = ptr;
+        free(ptr);
+    }
+    report("scratch_round_trip", "malloc", 64, 1, 1, TEMP_OPS, now_ns() - t0);
+}
+
+constexpr size_t FILL_SIZE = megabytes(64);
+
+static double fill_arena(size_t perCommitSize, unsigned int flags) {
+    auto arena = arena_init(FILL_SIZE, perCommitSize, flags);
+    size_t ops = FILL_SIZE / 64;
+
+    double t0 = now_ns();
+    for (size_t i = 0; i < ops; i++) {
+        char *ptr = arena_push<char>(&arena, 64);
+        ptr[0] = 1;     // touch, page faults are part of growth
+    }
+    double ns = now_ns() - t0;
+    arena_free(&arena);
+    return ns;
+}
+
+static void bench_commit_growth() {
+    const size_t perCommitSizes[] = { kilobytes(4), kilobytes(8), kilobytes(64), megabytes(1), megabytes(2) };
+    for (size_t perCommitSize : perCommitSizes) {
+        report("commit_growth", "arena", perCommitSize, 1, 1, FILL_SIZE / 64, fill_arena(perCommitSize, 0));
+        // no mprotect per commit step, only the page faults remain
+        double ns = fill_arena(perCommitSize, ARENA_FLAG_DEMAND_PAGED);
+        report("commit_growth", "arena_demand", perCommitSize, 1, 1, FILL_SIZE / 64, ns);
+    }
+}
+
+constexpr size_t THREAD_OPS = 1u << 20;
+
+template <typename Fn>
+static double run_threads(unsigned int threadCount, Fn fn) {
+    std::vector<std::thread> threads;
+    double t0 = now_ns();
+    for (unsigned int i = 0; i < threadCount; i++)
+        threads.emplace_back(fn);
+    for (auto &thread : threads)
+        thread.join();
+    return now_ns() - t0;
+}
+
+static void bench_threads(unsigned int threadCount) {
+    double ns = run_threads(threadCount, []() {
+        for (size_t i = 0; i < THREAD_OPS; i++) {
+            auto scratch = scratch_begin();
+            for (int j = 0; j < 8; j++)
+                benchSink = arena_push<char>(scratch.arena, 48);
+            scratch_end(scratch);
+        }
+        scratches_free();
+    });
+    report("threaded_scratch", "arena", 48, 1, threadCount, THREAD_OPS * 8 * threadCount, ns);
+
+    ns = run_threads(threadCount, []() {
+        void *ptrs[8];
+        for (size_t i = 0; i < THREAD_OPS; i++) {
+            for (int j = 0; j < 8; j++)
+                ptrs[j] = malloc(48);
+            for (int j = 0; j < 8; j++)
+                free(ptrs[j]);
+        }
+    });
+    report("threaded_scratch", "malloc", 48, 1, threadCount, THREAD_OPS * 8 * threadCount, ns);
+
+    // commit syscalls contend on the process wide mmap lock
+    size_t perCommitSize = ARENA_DEFAULT_PER_COMMIT_SIZE;
+    ns = run_threads(threadCount, [=]() { fill_arena(perCommitSize, 0); });
+    report("threaded_commit_growth", "arena", perCommitSize, 1, threadCount, FILL_SIZE / 64 * threadCount, ns);
+
+    ns = run_threads(threadCount, [=]() { fill_arena(perCommitSize, ARENA_FLAG_DEMAND_PAGED); });
+    report("threaded_commit_growth", "arena_demand", perCommitSize, 1, threadCount, FILL_SIZE / 64 * threadCount, ns);
+}
+
+int main() {
+    const size_t sizes[] = { 8, 16, 64, 256, 4096 };
+    const size_t aligns[] = { 1, 8, 64 };
+    for (size_t size : sizes)
+        for (size_t align : aligns)
+            bench_push(size, align);
+
+#if _IS_OS_LINUX
+    int fd = counter_open();
+    if (fd >= 0) {
+        for (size_t size : sizes)
+            bench_push_instructions(fd, size);
+        close(fd);
+    }
+#endif
+
+    bench_temp();
+    bench_commit_growth();
+
+    unsigned int threadCount = std::thread::hardware_concurrency();
+    bench_threads(1);
+    if (threadCount > 1) bench_threads(threadCount);
+    return 0;
+}
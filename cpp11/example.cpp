@@ -3,56 +3,15 @@
 #include <stdio.h>
 #include <stdarg.h>
 
-const char *cstr_fmtva(Arena *arena, const char *fmt, va_list args) {
-    va_list copyArgs;
-    va_copy(copyArgs, args);
-
-    int bytes = vsnprintf(0, 0, fmt, args);
-    if (bytes < 0) {
-        assert(false && "vsnprintf(): failed");
-        va_end(copyArgs);
-        return nullptr;
-    }
-
-    auto arenaState = arena_temp_begin(arena);
-
-    size_t neededBytes = bytes + 1ull;
-    char *ptr = arena_push<char>(arena, neededBytes);
-    if (ptr == nullptr) {
-        va_end(copyArgs);
-        return nullptr;
-    }
-
-    int len = vsnprintf(ptr, neededBytes, fmt, copyArgs);
-    va_end(copyArgs);
-
-    if (len < 0) {
-        arena_temp_end(arenaState);
-
-        assert(false && "vsnprintf(): failed");
-        return nullptr;
-    }
-
-    return ptr;
-}
-
-const char *cstr_fmt(Arena *arena, const char *fmt, ...) {
-    va_list args;
-    va_start(args, fmt);
-    const char *res = cstr_fmtva(arena, fmt, args);
-    va_end(args);
-    return res;
-}
-
 void tprintln_fmt(const char *fmt, ...) {
     auto scratch = scratch_begin();
 
     va_list args;
     va_start(args, fmt);
-    const char *ptr = cstr_fmtva(scratch.arena, fmt, args);
+    Arena_Str str = arena_str_fmtva(scratch.arena, fmt, args);
     va_end(args);
 
-    puts(ptr);
+    puts(str.ptr);
 
     scratch_end(scratch);
 }
@@ -60,8 +19,9 @@ void tprintln_fmt(const char *fmt, ...) {
 int main() {
     auto arena = arena_init(gigabytes(256), kilobytes(8));
 
-    const char *cStr = cstr_fmt(&arena, "This is a test: \t%d", 46);
-    puts(cStr);
+    Arena_Str str = arena_str_fmt(&arena, "This is a test: \t%d", 46);
+    str = arena_str_append_fmt(&arena, str, ", appended in place: %s", "yes");
+    puts(str.ptr);
 
     arena_free(&arena);
 
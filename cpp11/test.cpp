@@ -0,0 +1,362 @@
+// g++ -std=c++17 -pthread test.cpp -o test
+// prints each failed check, exits non-zero when any failed
+
+#include "arena.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+static int failedChecks = 0;
+
+static bool _check_failed(const char *expr, const char *file, int line) {
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+    failedChecks++;
+    return false;
+}
+
+// not assert, so it still checks under NDEBUG. false on failure
+#define check(cond)     ((cond) ? true : _check_failed(#cond, __FILE__, __LINE__))
+
+static bool is_zero(const char *ptr, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        if (ptr[i] != 0) return false;
+    }
+    return true;
+}
+
+static void test_ring_align() {
+    Arena_Ring ring = {};
+    if (!check(arena_ring_init(&ring, megabytes(1)))) return;
+
+    size_t granularity = _arena_ring_granularity();
+    for (int i = 0; i < 64; i++) {
+        check(arena_ring_push<char>(&ring, 100) != nullptr);
+        char *ptr = static_cast<char *>(arena_ring_push_ex(&ring, 100, granularity));
+        check(ptr != nullptr && reinterpret_cast<size_t>(ptr) % granularity == 0);
+        arena_ring_release_to(&ring, arena_ring_get_pos(&ring));
+    }
+    arena_ring_free(&ring);
+}
+
+static void test_chained_pop() {
+    Arena arena = arena_init(kilobytes(64), kilobytes(4), ARENA_FLAG_CHAINED);
+    if (!check(arena.ptr != nullptr)) return;
+
+    char *first = arena_push<char>(&arena, kilobytes(40));
+    if (!check(first != nullptr)) return;
+    memset(first, 1, kilobytes(40));
+    size_t mark = arena_get_pos(&arena);
+
+    // each push past the first block starts a new one
+    for (int i = 0; i < 4; i++) {
+        char *ptr = arena_push<char>(&arena, kilobytes(40));
+        if (!check(ptr != nullptr)) return;
+        memset(ptr, 2, kilobytes(40));
+    }
+    check(arena.prev != nullptr);
+    check(arena_get_pos(&arena) == mark + kilobytes(4 * 40));
+
+    // back into the first block, its contents survive
+    arena_pop_to(&arena, kilobytes(20));
+    check(arena.prev == nullptr);
+    check(arena_get_pos(&arena) == kilobytes(20));
+    check(first[0] == 1 && first[kilobytes(20) - 1] == 1);
+
+    char *next = arena_push<char>(&arena, 16);
+    check(next == first + kilobytes(20));
+
+    arena_pop_to(&arena, 0);
+    check(arena_get_pos(&arena) == 0);
+    arena_free(&arena);
+}
+
+static void test_push_zero_reuse() {
+    Arena arena = arena_init(megabytes(1), kilobytes(64));
+    if (!check(arena.ptr != nullptr)) return;
+
+    char *dirty = arena_push_nozero<char>(&arena, kilobytes(100));
+    if (!check(dirty != nullptr)) return;
+    memset(dirty, 0xff, kilobytes(100));
+
+    // popped bytes are handed out again, push_zero must clear them
+    arena_pop_to(&arena, kilobytes(10));
+    char *zero = arena_push_zero<char>(&arena, kilobytes(50));
+    check(zero == dirty + kilobytes(10));
+    check(zero != nullptr && is_zero(zero, kilobytes(50)));
+
+    arena_pop_to(&arena, 0);
+    zero = arena_push_zero<char>(&arena, kilobytes(200));
+    check(zero != nullptr && is_zero(zero, kilobytes(200)));
+    arena_free(&arena);
+}
+
+static void test_shared_overflow() {
+    Arena_Shared arena;
+    if (!check(arena_shared_init(&arena, kilobytes(64), kilobytes(16)))) return;
+
+    // a push that doesn't fit fails without moving pos, smaller ones still fit
+    check(arena_shared_push<char>(&arena, kilobytes(60)) != nullptr);
+    check(arena_shared_push<char>(&arena, kilobytes(8)) == nullptr);
+    check(arena_shared_get_pos(&arena) == kilobytes(60));
+    check(arena_shared_push<char>(&arena, kilobytes(4)) != nullptr);
+    check(arena_shared_get_pos(&arena) == kilobytes(64));
+    check(arena_shared_push<char>(&arena, 1) == nullptr);
+
+    // threads racing to the end fill the reservation exactly
+    arena_shared_pop_to(&arena, 0);
+    size_t counts[4] = {};
+    std::thread threads[4];
+    for (int i = 0; i < 4; i++) {
+        threads[i] = std::thread([&arena, &counts, i]() {
+            while (arena_shared_push<char>(&arena, ARENA_SHARED_GRAIN) != nullptr)
+                counts[i]++;
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    check(counts[0] + counts[1] + counts[2] + counts[3] == kilobytes(64) / ARENA_SHARED_GRAIN);
+    check(arena_shared_get_pos(&arena) == kilobytes(64));
+    arena_shared_free(&arena);
+}
+
+#if defined(NDEBUG)
+
+// an overflowing push asserts otherwise
+static void test_fmt_overflow_push_zero() {
+    Arena arena = arena_init(kilobytes(64), kilobytes(64));
+    if (!check(arena.ptr != nullptr && arena_push<char>(&arena, 16) != nullptr)) return;
+    arena_pop_to(&arena, 0);
+
+    // fills the committed tail, then fails to push past the reserve
+    size_t len = kilobytes(100);
+    char *big = static_cast<char *>(malloc(len + 1));
+    memset(big, 'x', len);
+    big[len] = '\0';
+    check(arena_str_fmt(&arena, "%s", big).ptr == nullptr);
+    check(arena_get_pos(&arena) == 0);
+    free(big);
+
+    char *zero = arena_push_zero<char>(&arena, kilobytes(64));
+    check(zero != nullptr && is_zero(zero, kilobytes(64)));
+    arena_free(&arena);
+}
+
+struct Unchecked_Policy : Arena_Default_Policy {
+    static constexpr bool boundsCheck = false;
+    static constexpr bool stats = true;
+};
+
+// unchecked pushes past the reservation fail and aren't counted
+static void test_basic_arena_overflow() {
+    auto arena = basic_arena_init<Unchecked_Policy>(kilobytes(64), kilobytes(64));
+    if (!check(arena.arena.ptr != nullptr)) return;
+
+    check(basic_arena_push<char>(&arena, kilobytes(60)) != nullptr);
+    check(basic_arena_push<char>(&arena, kilobytes(8)) == nullptr);
+    check(basic_arena_get_pos(&arena) == kilobytes(60));
+    check(arena.stats.pushCount == 1 && arena.stats.pushBytes == kilobytes(60));
+    basic_arena_free(&arena);
+}
+
+#endif
+
+static void test_map_grow() {
+    Arena arena = arena_init(megabytes(16));
+    if (!check(arena.ptr != nullptr)) return;
+
+    auto map = arena_map_init<int, int>(&arena, 4);
+    for (int i = 0; i < 10000; i++) {
+        int *value = arena_map_put(&map, i * 7);
+        if (!check(value != nullptr)) return;
+        *value = i;
+    }
+    check(map.count == 10000);
+    check(map.cap >= 10000 * 4 / 3);
+    // the table was the last push, every growth happened in place
+    check(arena_get_pos(&arena) == sizeof(*map.slots) * map.cap);
+
+    bool found = true;
+    for (int i = 0; i < 10000; i++) {
+        int *value = arena_map_get(&map, i * 7);
+        found = found && value != nullptr && *value == i;
+    }
+    check(found);
+    check(arena_map_get(&map, 1) == nullptr);
+
+    check(arena_map_remove(&map, 7));
+    check(!arena_map_remove(&map, 7));
+    check(arena_map_get(&map, 7) == nullptr);
+    check(arena_map_get(&map, 14) != nullptr);
+
+    // not the last push anymore, grows into a new table
+    arena_push<char>(&arena, 1);
+    size_t cap = map.cap;
+    for (int i = 10000; map.cap == cap; i++)
+        arena_map_put(&map, i * 7);
+    found = true;
+    for (int i = 2; i < 10000; i++) {
+        int *value = arena_map_get(&map, i * 7);
+        found = found && value != nullptr && *value == i;
+    }
+    check(found);
+
+    // updating a key at the load limit doesn't grow
+    auto full = arena_map_init<int, int>(&arena, 16);
+    for (int i = 0; i < 12; i++)
+        arena_map_put(&full, i);
+    check(full.cap == 16);
+    check(arena_map_put(&full, 5) != nullptr);
+    check(full.cap == 16 && full.count == 12);
+
+    // a map without a table, as left by a failed init
+    Arena_Map<int, int> empty = { &arena, nullptr, 0, 0 };
+    check(arena_map_get(&empty, 1) == nullptr);
+    check(!arena_map_remove(&empty, 1));
+    int *value = arena_map_put(&empty, 1);
+    check(value != nullptr && *value == 0);
+    check(empty.cap == ARENA_MAP_DEFAULT_CAP && arena_map_get(&empty, 1) == value);
+    arena_free(&arena);
+}
+
+static int liveObjects = 0;
+
+struct Counted {
+    Counted() {
+        if (liveObjects == 3) throw 1;
+        liveObjects++;
+    }
+    ~Counted() { liveObjects--; }
+};
+
+static void test_new_array_throw() {
+    Arena arena = arena_init(megabytes(1));
+    if (!check(arena.ptr != nullptr)) return;
+    arena_push<char>(&arena, 10);
+
+    // the fourth constructor throws, the three before it are destroyed
+    bool thrown = false;
+    try {
+        arena_new_array<Counted>(&arena, 8);
+    } catch (int) {
+        thrown = true;
+    }
+    check(thrown);
+    check(liveObjects == 0);
+    check(arena_get_pos(&arena) == 10);
+
+    Counted *objects = arena_new_array<Counted>(&arena, 3);
+    check(objects != nullptr && liveObjects == 3);
+    arena_pop_to(&arena, 10);
+    check(liveObjects == 0);
+
+    static_assert(std::is_nothrow_move_constructible<Temp_Scope>::value, "containers move scopes");
+    static_assert(std::is_nothrow_move_assignable<Temp_Scope>::value, "containers move scopes");
+    arena_free(&arena);
+}
+
+static void test_allocator_overflow() {
+    Arena arena = arena_init(megabytes(1));
+    Arena_Allocator<int> alloc(&arena);
+    bool thrown = false;
+    try {
+        (void)alloc.allocate(SIZE_MAX / 2);
+    } catch (const std::bad_alloc &) {
+        thrown = true;
+    }
+    check(thrown);
+    check(arena_get_pos(&arena) == 0);
+    arena_free(&arena);
+}
+
+#if _IS_OS_LINUX
+
+static void test_shm_overflow() {
+    Arena_Shm arena;
+    if (!check(arena_shm_create(&arena, nullptr, kilobytes(64), kilobytes(16)))) return;
+
+    // as with Arena_Shared, a failed push leaves pos within the reservation
+    check(arena_shm_push<char>(&arena, kilobytes(60)) != nullptr);
+    check(arena_shm_push<char>(&arena, kilobytes(8)) == nullptr);
+    check(arena_shm_get_pos(&arena) == kilobytes(60));
+    check(arena_shm_push<char>(&arena, kilobytes(4)) != nullptr);
+    check(arena_shm_get_pos(&arena) == kilobytes(64));
+    arena_shm_close(&arena);
+}
+
+static void test_file_read_only() {
+    char path[] = "/tmp/arena_test_XXXXXX";
+    int fd = mkstemp(path);
+    if (!check(fd != -1)) return;
+    close(fd);
+
+    auto arena = arena_file_create(path, megabytes(1));
+    Arena_Str str = arena_str_fmt(&arena, "saved %d", 1);
+    check(str.ptr != nullptr);
+    check(arena_file_save(&arena));
+    arena_free(&arena);
+
+    arena = arena_file_open(path, ARENA_FILE_READ_ONLY);
+    if (!check(arena.ptr != nullptr)) return;
+    str = { static_cast<char *>(arena.ptr), 7 };
+    check(strcmp(str.ptr, "saved 1") == 0);
+
+    size_t pos = arena_get_pos(&arena);
+    check(arena_push<char>(&arena, 1) == nullptr);
+    check(arena_str_fmt(&arena, "%d", 2).ptr == nullptr);
+    check(arena_str_append(&arena, str, "x", 1).ptr == nullptr);
+    check(arena_get_pos(&arena) == pos);
+
+    // room below the old pos is still read-only
+    arena_pop_to(&arena, 0);
+    check(arena_push<char>(&arena, 1) == nullptr);
+
+    // allocators over a full arena throw instead of returning null
+    bool thrown = false;
+    try {
+        std::vector<int, Arena_Allocator<int>> vec{ Arena_Allocator<int>(&arena) };
+        vec.push_back(1);
+    } catch (const std::bad_alloc &) {
+        thrown = true;
+    }
+    check(thrown);
+#if _HAS_PMR
+    thrown = false;
+    try {
+        Arena_Resource res(&arena);
+        (void)res.allocate(16, 8);
+    } catch (const std::bad_alloc &) {
+        thrown = true;
+    }
+    check(thrown);
+#endif
+    arena_free(&arena);
+    unlink(path);
+}
+
+#endif
+
+int main() {
+    test_ring_align();
+    test_chained_pop();
+    test_push_zero_reuse();
+    test_shared_overflow();
+#if defined(NDEBUG)
+    test_fmt_overflow_push_zero();
+    test_basic_arena_overflow();
+#endif
+    test_map_grow();
+    test_new_array_throw();
+    test_allocator_overflow();
+#if _IS_OS_LINUX
+    test_shm_overflow();
+    test_file_read_only();
+#endif
+    if (failedChecks != 0) {
+        fprintf(stderr, "%d checks failed\n", failedChecks);
+        return 1;
+    }
+    puts("ok");
+    return 0;
+}